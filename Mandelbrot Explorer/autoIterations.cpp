@@ -0,0 +1,84 @@
+#include "autoIterations.h"
+
+#include <algorithm>
+
+
+static const int PROBE_WIDTH = 128;
+static const int PROBE_HEIGHT = 96;
+// more late escapes than this and the boundary is still being cut off by the cap
+static const double LATE_FRACTION = 0.001;
+
+IterationStats gatherIterationStats(const std::vector<int>& iterations, int maxIterations) {
+	IterationStats stats = { maxIterations, (long long)iterations.size(), 0, 0, 0, 0 };
+	int lateThreshold = maxIterations - maxIterations / 4;
+	std::vector<int> escaped;
+	escaped.reserve(iterations.size());
+	for (int i : iterations) {
+		if (i == PROVEN_INTERIOR) {
+			stats.interior++;
+			continue;
+		}
+		if (i >= maxIterations) {
+			stats.unresolved++;
+			continue;
+		}
+		if (i >= lateThreshold)
+			stats.lateEscapes++;
+		escaped.push_back(i);
+	}
+	if (!escaped.empty()) {
+		size_t k = std::min(escaped.size() - 1, escaped.size() * 999 / 1000);
+		std::nth_element(escaped.begin(), escaped.begin() + k, escaped.end());
+		stats.escapeP999 = escaped[k];
+	}
+	return stats;
+}
+
+int chooseMaxIterations(const IterationStats& stats, int ceiling) {
+	int current = stats.maxIterations;
+	int chosen = current;
+	long long escaped = stats.pixels - stats.interior - stats.unresolved;
+	if (stats.pixels > 0 && (double)stats.lateEscapes / stats.pixels > LATE_FRACTION) {
+		chosen = current * 2;
+	}
+	else if (escaped == 0 && stats.unresolved > 0) {
+		// nothing has escaped yet, typical of a deep view at a low budget, so there is nothing to judge by
+		chosen = current * 2;
+	}
+	else if (stats.escapeP999 < current / 4) {
+		// twice the slowest escape keeps it out of the late quarter, so the next frame won't grow again
+		chosen = stats.escapeP999 * 2;
+	}
+	return std::max(MIN_AUTO_ITERATIONS, std::min(chosen, ceiling));
+}
+
+int probeMaxIterations(double centerX, double centerY, double scale, int maxIterations, int ceiling, ThreadPool& pool,
+	const KernelVariant& variant) {
+	std::vector<int> iterations(PROBE_WIDTH * PROBE_HEIGHT);
+	KernelVariant probe = variant;
+	probe.interiorCheck = true;
+	withKernel(probe, [&](const auto& kernel) {
+		double cr[PROBE_WIDTH];
+		for (int px = 0; px < PROBE_WIDTH; px++)
+			cr[px] = pixelReal(centerX, scale, px, PROBE_WIDTH);
+		pool.parallelFor(PROBE_HEIGHT, [&](int py) {
+			int* row = &iterations[py * PROBE_WIDTH];
+			bool periodic[PROBE_WIDTH];
+			kernel.row(cr, pixelImaginary(centerY, scale, py, PROBE_HEIGHT), PROBE_WIDTH, maxIterations, row, periodic);
+			for (int px = 0; px < PROBE_WIDTH; px++)
+				row[px] = periodic[px] ? PROVEN_INTERIOR : row[px];
+		});
+	});
+	return chooseMaxIterations(gatherIterationStats(iterations, maxIterations), ceiling);
+}
+
+int probeMaxIterations(const DeepView& view, int maxIterations, int ceiling, ThreadPool& pool, OrbitCache* cache) {
+	DeepView probe = view;
+	probe.width = PROBE_WIDTH;
+	probe.height = PROBE_HEIGHT;
+	std::vector<int> iterations(PROBE_WIDTH * PROBE_HEIGHT);
+	PerturbationOptions options;
+	options.cache = cache;
+	renderPerturbation(probe, maxIterations, pool, iterations.data(), options);
+	return chooseMaxIterations(gatherIterationStats(iterations, maxIterations), ceiling);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "formula.h"
+#include "perturbation.h"
+#include "threadPool.h"
+
+// automatic maxIterations: looks at how the last frame's pixels escaped and picks the smallest budget
+// that still resolves the view. grows when a noticeable fraction of pixels only escaped near the cap or
+// when nothing has escaped yet, shrinks when every escaping pixel finished well below it. pixels proven
+// to be interior never count as unresolved, so views of the inside of the set stay cheap.
+static const int MIN_AUTO_ITERATIONS = 64;
+// iteration value marking a pixel that was proven to be inside the set
+static const int PROVEN_INTERIOR = 0;
+
+struct IterationStats {
+	int maxIterations;
+	long long pixels;
+	long long interior; // proven to be inside the set
+	long long unresolved; // hit the cap without being proven interior
+	long long lateEscapes; // escaped in the last quarter of the budget
+	int escapeP999; // 99.9th percentile iteration count of the pixels that escaped
+};
+
+// iterations as counted by the kernels, so a value of maxIterations means the pixel never escaped
+// and PROVEN_INTERIOR means it never will
+IterationStats gatherIterationStats(const std::vector<int>& iterations, int maxIterations);
+
+int chooseMaxIterations(const IterationStats& stats, int ceiling);
+
+// renders a coarse grid of the view on the CPU to stand in for the last frame, then chooses from it.
+// the probe always runs the formula's interior check, whatever the variant's is
+int probeMaxIterations(double centerX, double centerY, double scale, int maxIterations, int ceiling, ThreadPool& pool,
+	const KernelVariant& variant = KernelVariant());
+
+// the same for a view past double precision, whose probe pixels would all round to one c. the grid is
+// rendered with perturbation against the cache's references, and has no interior check
+int probeMaxIterations(const DeepView& view, int maxIterations, int ceiling, ThreadPool& pool, OrbitCache* cache);
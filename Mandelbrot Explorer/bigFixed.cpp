@@ -0,0 +1,289 @@
+#include "bigFixed.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+BigFixed::BigFixed(int fractionLimbs) : limbs(fractionLimbs + 1, 0) {}
+
+int BigFixed::limbsForScale(const FloatExp& scale) {
+	int64_t bits = scale.m > 0 ? -scale.e : 0;
+	if (bits < 0)
+		bits = 0;
+	return (int)((bits + 64 + 31) / 32);
+}
+
+BigFixed BigFixed::fromDouble(double value, int fractionLimbs) {
+	if (!isfinite(value))
+		return BigFixed(fractionLimbs);
+	return fromFloatExp(FloatExp(value), fractionLimbs);
+}
+
+BigFixed BigFixed::fromFloatExp(const FloatExp& value, int fractionLimbs) {
+	BigFixed result(fractionLimbs);
+	if (value.isZero())
+		return result;
+	result.negative = value.m < 0;
+
+	uint64_t bits = (uint64_t)ldexp(fabs(value.m), 52);
+	// the value is bits * 2^(e - 52); place each bit relative to the bottom of the fraction
+	int64_t shift = value.e - 52 + 32 * (int64_t)fractionLimbs;
+	for (int b = 0; b < 53; b++) {
+		if (!(bits >> b & 1))
+			continue;
+		int64_t position = b + shift;
+		if (position >= 0 && position < 32 * (int64_t)(fractionLimbs + 1))
+			result.limbs[position / 32] |= 1u << (position % 32);
+	}
+	return result;
+}
+
+BigFixed BigFixed::fromLimbs(const uint32_t* magnitude, int fractionLimbs, bool negative) {
+	BigFixed result(fractionLimbs);
+	result.limbs.assign(magnitude, magnitude + fractionLimbs + 1);
+	result.negative = negative && !result.isZero();
+	return result;
+}
+
+bool BigFixed::parse(const std::string& text, int fractionLimbs, BigFixed& out) {
+	size_t i = 0;
+	bool negative = false;
+	if (i < text.size() && (text[i] == '-' || text[i] == '+'))
+		negative = text[i++] == '-';
+
+	std::string integerDigits, fractionDigits;
+	while (i < text.size() && isdigit((unsigned char)text[i]))
+		integerDigits += text[i++];
+	if (i < text.size() && text[i] == '.') {
+		i++;
+		while (i < text.size() && isdigit((unsigned char)text[i]))
+			fractionDigits += text[i++];
+	}
+	if (integerDigits.empty() && fractionDigits.empty())
+		return false;
+
+	int exponent = 0;
+	if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+		char* end;
+		exponent = (int)strtol(text.c_str() + i + 1, &end, 10);
+		if (end == text.c_str() + i + 1)
+			return false;
+		i = end - text.c_str();
+	}
+	if (i != text.size())
+		return false;
+
+	// move the decimal point to apply the exponent
+	std::string digits = integerDigits + fractionDigits;
+	int pointPosition = (int)integerDigits.size() + exponent;
+	if (pointPosition < 0) {
+		digits.insert(0, -pointPosition, '0');
+		pointPosition = 0;
+	}
+	if (pointPosition > (int)digits.size())
+		digits.append(pointPosition - digits.size(), '0');
+	integerDigits = digits.substr(0, pointPosition);
+	fractionDigits = digits.substr(pointPosition);
+	if (integerDigits.size() > 9)
+		return false;
+
+	BigFixed result(fractionLimbs);
+	// the fraction from its last digit up: r = (digit + r) / 10, one long division per digit
+	for (int d = (int)fractionDigits.size() - 1; d >= 0; d--) {
+		result.limbs.back() = fractionDigits[d] - '0';
+		uint64_t remainder = 0;
+		for (int l = fractionLimbs; l >= 0; l--) {
+			uint64_t current = remainder << 32 | result.limbs[l];
+			result.limbs[l] = (uint32_t)(current / 10);
+			remainder = current % 10;
+		}
+	}
+	result.limbs.back() = integerDigits.empty() ? 0 : (uint32_t)strtoul(integerDigits.c_str(), NULL, 10);
+	result.negative = negative && !result.isZero();
+	out = result;
+	return true;
+}
+
+double BigFixed::toDouble() const {
+	double value = 0;
+	int n = fractionLimbs();
+	for (int l = n; l >= 0; l--) {
+		if (limbs[l])
+			value += ldexp((double)limbs[l], 32 * (l - n));
+	}
+	return negative ? -value : value;
+}
+
+FloatExp BigFixed::toFloatExp() const {
+	// the top three limbs from the highest nonzero one hold more bits than the mantissa keeps
+	int n = fractionLimbs();
+	int top = n;
+	while (top >= 0 && !limbs[top])
+		top--;
+	if (top < 0)
+		return FloatExp();
+	double value = 0;
+	for (int l = top; l >= 0 && l > top - 3; l--)
+		value += ldexp((double)limbs[l], 32 * (l - top));
+	FloatExp result(value, 32 * (int64_t)(top - n));
+	return negative ? -result : result;
+}
+
+std::string BigFixed::fractionText(int fractionDigits, bool& remainder) const {
+	std::string text;
+	// multiply the fraction by ten repeatedly, the carry out of the top is the next digit
+	std::vector<uint32_t> fraction(limbs.begin(), limbs.end() - 1);
+	for (int d = 0; d < fractionDigits; d++) {
+		uint64_t carry = 0;
+		for (size_t l = 0; l < fraction.size(); l++) {
+			uint64_t current = (uint64_t)fraction[l] * 10 + carry;
+			fraction[l] = (uint32_t)current;
+			carry = current >> 32;
+		}
+		text += (char)('0' + carry);
+	}
+	remainder = false;
+	for (uint32_t l : fraction)
+		remainder = remainder || l != 0;
+	return text;
+}
+
+std::string BigFixed::toString(int fractionDigits) const {
+	std::string text = negative ? "-" : "";
+	text += std::to_string(limbs.back());
+	if (fractionDigits <= 0)
+		return text;
+	bool remainder;
+	return text + '.' + fractionText(fractionDigits, remainder);
+}
+
+std::string BigFixed::toExactString() const {
+	// one more digit than the fraction has bits' worth puts the last digit below the last bit. parse
+	// truncates, so a cut off decimal is rounded away from zero to land back on this value
+	int digits = (int)ceil(32 * fractionLimbs() * 0.30102999566398120) + 1;
+	bool remainder;
+	std::string text = std::to_string(limbs.back()) + '.' + fractionText(digits, remainder);
+	if (remainder) {
+		int i = (int)text.size() - 1;
+		for (; i >= 0; i--) {
+			if (text[i] == '.')
+				continue;
+			if (text[i] != '9') {
+				text[i]++;
+				break;
+			}
+			text[i] = '0';
+		}
+		if (i < 0)
+			text.insert(0, 1, '1');
+	}
+	while (text.back() == '0')
+		text.pop_back();
+	if (text.back() == '.')
+		text.pop_back();
+	return negative ? "-" + text : text;
+}
+
+BigFixed BigFixed::withPrecision(int fractionLimbs) const {
+	BigFixed result(fractionLimbs);
+	result.negative = negative;
+	int from = this->fractionLimbs();
+	for (int l = 0; l <= from; l++) {
+		int target = l - from + fractionLimbs;
+		if (target >= 0)
+			result.limbs[target] = limbs[l];
+	}
+	result.negative = negative && !result.isZero();
+	return result;
+}
+
+bool BigFixed::isZero() const {
+	for (uint32_t l : limbs) {
+		if (l)
+			return false;
+	}
+	return true;
+}
+
+int BigFixed::compareMagnitude(const BigFixed& a, const BigFixed& b) {
+	for (int l = (int)a.limbs.size() - 1; l >= 0; l--) {
+		if (a.limbs[l] != b.limbs[l])
+			return a.limbs[l] < b.limbs[l] ? -1 : 1;
+	}
+	return 0;
+}
+
+BigFixed BigFixed::addSigned(const BigFixed& a, const BigFixed& b, bool negateB) {
+	// operands of different precision are widened to the finer one so the limbs line up
+	if (a.fractionLimbs() < b.fractionLimbs())
+		return addSigned(a.withPrecision(b.fractionLimbs()), b, negateB);
+	if (b.fractionLimbs() < a.fractionLimbs())
+		return addSigned(a, b.withPrecision(a.fractionLimbs()), negateB);
+	bool bNegative = b.negative != negateB;
+	BigFixed result(a.fractionLimbs());
+	size_t n = a.limbs.size();
+	if (a.negative == bNegative) {
+		uint64_t carry = 0;
+		for (size_t l = 0; l < n; l++) {
+			uint64_t sum = (uint64_t)a.limbs[l] + b.limbs[l] + carry;
+			result.limbs[l] = (uint32_t)sum;
+			carry = sum >> 32;
+		}
+		result.negative = a.negative;
+	}
+	else {
+		// subtract the smaller magnitude from the larger, the sign follows the larger
+		bool aLarger = compareMagnitude(a, b) >= 0;
+		const BigFixed& large = aLarger ? a : b;
+		const BigFixed& small = aLarger ? b : a;
+		int64_t borrow = 0;
+		for (size_t l = 0; l < n; l++) {
+			int64_t difference = (int64_t)large.limbs[l] - small.limbs[l] - borrow;
+			borrow = difference < 0;
+			result.limbs[l] = (uint32_t)(difference + (borrow << 32));
+		}
+		result.negative = aLarger ? a.negative : bNegative;
+	}
+	result.negative = result.negative && !result.isZero();
+	return result;
+}
+
+BigFixed BigFixed::operator+(const BigFixed& other) const {
+	return addSigned(*this, other, false);
+}
+
+BigFixed BigFixed::operator-(const BigFixed& other) const {
+	return addSigned(*this, other, true);
+}
+
+BigFixed BigFixed::operator-() const {
+	BigFixed result = *this;
+	result.negative = !negative && !isZero();
+	return result;
+}
+
+BigFixed BigFixed::operator*(const BigFixed& other) const {
+	if (fractionLimbs() < other.fractionLimbs())
+		return withPrecision(other.fractionLimbs()) * other;
+	if (other.fractionLimbs() < fractionLimbs())
+		return *this * other.withPrecision(fractionLimbs());
+	int n = fractionLimbs();
+	size_t count = limbs.size();
+	// schoolbook product, keeping only the limbs from the fraction's bottom up to the integer limb
+	std::vector<uint64_t> product(2 * count + 1, 0);
+	for (size_t i = 0; i < count; i++) {
+		if (!limbs[i])
+			continue;
+		uint64_t carry = 0;
+		for (size_t j = 0; j < count; j++) {
+			uint64_t current = (uint64_t)limbs[i] * other.limbs[j] + product[i + j] + carry;
+			product[i + j] = (uint32_t)current;
+			carry = current >> 32;
+		}
+		product[i + count] += carry;
+	}
+	BigFixed result(n);
+	for (size_t l = 0; l < count; l++)
+		result.limbs[l] = (uint32_t)product[l + n];
+	result.negative = (negative != other.negative) && !result.isZero();
+	return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "floatExp.h"
+
+// arbitrary precision signed fixed point number: one 32 bit limb of integer part and a runtime chosen
+// number of 32 bit fraction limbs. enough for coordinates on the mandelbrot set at any zoom depth; used
+// where doubles run out, such as the reference orbits of perturbation rendering.
+class BigFixed {
+public:
+	explicit BigFixed(int fractionLimbs = 2);
+
+	static BigFixed fromDouble(double value, int fractionLimbs);
+	static BigFixed fromFloatExp(const FloatExp& value, int fractionLimbs);
+	// from a magnitude laid out as limb() returns it
+	static BigFixed fromLimbs(const uint32_t* magnitude, int fractionLimbs, bool negative);
+	// parses a decimal such as "-0.7436438870371587047521915061" (an exponent like "1e-5" is accepted too).
+	// returns false if the text isn't a number.
+	static bool parse(const std::string& text, int fractionLimbs, BigFixed& out);
+
+	// fraction limbs needed to resolve offsets of the given size, with 64 bits to spare
+	static int limbsForScale(const FloatExp& scale);
+
+	double toDouble() const;
+	// keeps the exponent of values too small for a double, such as the difference of two deep coordinates
+	FloatExp toFloatExp() const;
+	// decimal representation with the given number of fraction digits, truncated
+	std::string toString(int fractionDigits) const;
+	// the shortest decimal with a digit per fraction bit or so that parse() at this precision turns back into
+	// exactly this value
+	std::string toExactString() const;
+
+	int fractionLimbs() const { return (int)limbs.size() - 1; }
+	// limb i of the magnitude, least significant first; fractionLimbs() is the integer part
+	uint32_t limb(int i) const { return limbs[i]; }
+	BigFixed withPrecision(int fractionLimbs) const;
+	bool isNegative() const { return negative; }
+	bool isZero() const;
+
+	BigFixed operator+(const BigFixed& other) const;
+	BigFixed operator-(const BigFixed& other) const;
+	BigFixed operator*(const BigFixed& other) const;
+	BigFixed operator-() const;
+
+private:
+	static int compareMagnitude(const BigFixed& a, const BigFixed& b);
+	static BigFixed addSigned(const BigFixed& a, const BigFixed& b, bool negateB);
+	// fraction digits as toString writes them; remainder is set if the digits stop short of the exact value
+	std::string fractionText(int fractionDigits, bool& remainder) const;
+
+	bool negative = false;
+	std::vector<uint32_t> limbs; // magnitude, least significant first; the last limb is the integer part
+};
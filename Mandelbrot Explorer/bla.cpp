@@ -0,0 +1,46 @@
+#include "bla.h"
+
+#include <algorithm>
+#include <math.h>
+
+// relative size of the dropped delta^2 term that a single step tolerates
+static const double EPSILON = 1.0 / (1LL << 53);
+
+// x followed by y: A = Ay Ax, B = Ay Bx + By. the run stays valid while x's does and x's output stays
+// inside y's radius, |Ax| |delta| + |Bx| |deltaC| < Ry
+template <typename Real>
+static typename BlaTable<Real>::Step merge(const typename BlaTable<Real>::Step& x, const typename BlaTable<Real>::Step& y, Real deltaCMax) {
+	typename BlaTable<Real>::Step s;
+	s.ar = y.ar * x.ar - y.ai * x.ai;
+	s.ai = y.ar * x.ai + y.ai * x.ar;
+	s.br = y.ar * x.br - y.ai * x.bi + y.br;
+	s.bi = y.ar * x.bi + y.ai * x.br + y.bi;
+	Real aMagnitude = hypot(x.ar, x.ai);
+	Real yRadius = (y.radius - hypot(x.br, x.bi) * deltaCMax) / aMagnitude;
+	s.radius = std::min(x.radius, std::max(Real(0.0), aMagnitude > Real(0.0) ? yRadius : x.radius));
+	return s;
+}
+
+template <typename Real>
+BlaTable<Real>::BlaTable(const ReferenceOrbit& reference, Real deltaCMax) {
+	// single steps at n = 1 .. length - 2, the last Z only gets checked for escape
+	std::vector<Step> single;
+	CompactOrbit::Reader z(reference.z);
+	for (int n = 1; n + 1 < reference.length(); n++) {
+		z.next();
+		single.push_back({ Real(2 * z.zr), Real(2 * z.zi), Real(1.0), Real(0.0), Real(EPSILON * hypot(z.zr, z.zi)) });
+	}
+
+	while (true) {
+		const std::vector<Step>& below = levels.empty() ? single : levels.back();
+		if (below.size() < 2)
+			break;
+		std::vector<Step> level(below.size() / 2);
+		for (size_t i = 0; i < level.size(); i++)
+			level[i] = merge<Real>(below[2 * i], below[2 * i + 1], deltaCMax);
+		levels.push_back(std::move(level));
+	}
+}
+
+template class BlaTable<double>;
+template class BlaTable<FloatExp>;
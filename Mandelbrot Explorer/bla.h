@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "perturbation.h"
+
+// bilinear approximation of runs of perturbation steps. while |delta| stays below a step's validity radius
+// the delta iteration is linear to double precision, so l steps starting at n collapse to
+//   delta_{n+l} = A delta_n + B deltaC
+// the table is a merge tree over the reference orbit: level k holds runs of 2^(k+1) steps starting at
+// n = 1 + i 2^(k+1), built by composing pairs from the level below. a pixel takes the longest valid run at
+// each step, so long stretches near the reference cost a logarithmic number of lookups.
+// Real is the delta type of the pixels using the table: double, or FloatExp past double's range, where
+// A and B grow and the radii shrink beyond it as well.
+template <typename Real>
+class BlaTable {
+public:
+	struct Step {
+		Real ar, ai; // A
+		Real br, bi; // B
+		Real radius; // valid while |delta_n| < radius
+	};
+
+	// deltaCMax bounds |deltaC| of every pixel rendered against this reference
+	BlaTable(const ReferenceOrbit& reference, Real deltaCMax);
+
+	// the longest run starting at iteration n that is valid for delta and at most maxSteps long, or NULL.
+	// stepsTaken receives its length
+	const Step* find(int n, Real deltaNorm2, int maxSteps, int& stepsTaken) const {
+		// runs of 2^(k+1) steps start where n - 1 is a multiple of 2^(k+1), so the trailing zero bits
+		// of n - 1 give the highest level to try
+		unsigned int offset = (unsigned int)(n - 1);
+		if (offset & 1)
+			return nullptr;
+		int top = (int)levels.size() - 1;
+		if (offset != 0) {
+			int zeros = 0;
+			while (!(offset >> zeros & 1))
+				zeros++;
+			top = std::min(top, zeros - 1);
+		}
+		for (int level = top; level >= 0; level--) {
+			int length = 2 << level;
+			if (length > maxSteps)
+				continue;
+			size_t i = offset / length;
+			if (i >= levels[level].size())
+				continue;
+			const Step& step = levels[level][i];
+			if (deltaNorm2 < step.radius * step.radius) {
+				stepsTaken = length;
+				return &step;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	// levels[k] holds runs of 2^(k+1) steps; single steps are just as cheap to iterate directly
+	std::vector<std::vector<Step>> levels;
+};
@@ -0,0 +1,289 @@
+#include "buddhabrot.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "pngEncode.h"
+
+static const int CHANNELS = 3;
+
+// how far a mutation moves c, as a share of the view's half height, drawn log uniformly between the two so
+// a chain both refines around a good orbit and hops to nearby ones
+static const double SMALLEST_MUTATION = 1e-4, LARGEST_MUTATION = 0.1;
+// share of proposals drawn afresh from the whole of [-2, 2]^2, which keeps a chain from staying stuck in
+// one corner of the set
+static const double FRESH_PROPOSALS = 0.2;
+// uniform draws a chain makes to find a first orbit that crosses the view before it gives up
+static const int START_ATTEMPTS = 1000000;
+// samples between a chain's updates of the shared progress count
+static const int PROGRESS_INTERVAL = 1 << 16;
+
+namespace {
+	struct Orbit {
+		double cx = 0, cy = 0;
+		std::vector<double> x, y; // z_1 onwards
+		int iterations = 0;
+		// how many of its points are inside the view, 0 for one that doesn't escape in any band
+		int weight = 0;
+	};
+
+	class Chain {
+	public:
+		// printing, one chain of a render reports how far all of them have got
+		Chain(const BuddhabrotOptions& options, unsigned long long seed, std::vector<double>& histogram, bool printing)
+			: options(options), random(seed), histogram(histogram), printing(printing) {
+			longest = 0;
+			for (const BuddhabrotBand& band : options.bands)
+				longest = std::max(longest, band.maxIterations);
+			for (Orbit* orbit : { &current, &proposal }) {
+				orbit->x.resize(longest);
+				orbit->y.resize(longest);
+			}
+		}
+
+		// samples c values, and returns how many proposals were accepted
+		long long run(long long samples, std::atomic<long long>& progress) {
+			long long accepted = 0, done = 0;
+			if (!options.metropolis) {
+				for (; done < samples; done++) {
+					trace(uniform(random) * 4 - 2, uniform(random) * 4 - 2, current);
+					if (current.weight > 0)
+						splat(current, 1.0);
+					report(done, progress);
+				}
+				return 0;
+			}
+
+			// a chain has to start where orbits cross the view
+			for (int attempt = 0; attempt < START_ATTEMPTS && current.weight == 0 && done < samples; attempt++, done++)
+				trace(uniform(random) * 4 - 2, uniform(random) * 4 - 2, current);
+			if (current.weight == 0)
+				return 0;
+
+			// the chain's points have a density in proportion to how much of their orbit lands in the view, so each
+			// one counts 1 / weight of an orbit to leave the image as uniform sampling would draw it. a point the
+			// chain stays at is splatted once, for every sample it stayed
+			long long stayed = 1;
+			for (; done < samples; done++) {
+				double px, py;
+				if (uniform(random) < FRESH_PROPOSALS) {
+					px = uniform(random) * 4 - 2;
+					py = uniform(random) * 4 - 2;
+				}
+				else {
+					double radius = options.scale * SMALLEST_MUTATION * pow(LARGEST_MUTATION / SMALLEST_MUTATION, uniform(random));
+					double angle = uniform(random) * 6.283185307179586;
+					px = current.cx + radius * cos(angle);
+					py = current.cy + radius * sin(angle);
+				}
+				trace(px, py, proposal);
+				// both kinds of proposal are symmetric, so the acceptance is the ratio of the weights
+				if (proposal.weight > 0 && uniform(random) * current.weight < proposal.weight) {
+					splat(current, (double)stayed / current.weight);
+					std::swap(current, proposal);
+					stayed = 1;
+					accepted++;
+				}
+				else {
+					stayed++;
+				}
+				report(done, progress);
+			}
+			splat(current, (double)stayed / current.weight);
+			return accepted;
+		}
+
+	private:
+		// points whose orbits add nothing: the main cardioid and the period 2 bulb never escape, and outside
+		// the disk of radius 2 the orbit is c alone, which would only lay a flat haze over the image
+		static bool skipped(double cx, double cy) {
+			double q = (cx - 0.25) * (cx - 0.25) + cy * cy;
+			return q * (q + (cx - 0.25)) <= 0.25 * cy * cy || (cx + 1) * (cx + 1) + cy * cy <= 0.0625 || cx * cx + cy * cy >= 4;
+		}
+
+		bool inBand(int iterations, int channel) const {
+			return iterations >= options.bands[channel].minIterations && iterations <= options.bands[channel].maxIterations;
+		}
+
+		// the pixel of a point, false outside the view
+		bool pixel(double x, double y, int& px, int& py) const {
+			double fx = ((x - options.centerX) / options.scale + 1) * 0.5 * options.width;
+			double fy = (1 - (y - options.centerY) / options.scale) * 0.5 * options.height;
+			if (!(fx >= 0 && fy >= 0 && fx < options.width && fy < options.height))
+				return false;
+			px = (int)fx;
+			py = (int)fy;
+			return true;
+		}
+
+		void trace(double cx, double cy, Orbit& orbit) const {
+			orbit.cx = cx;
+			orbit.cy = cy;
+			orbit.iterations = 0;
+			orbit.weight = 0;
+			if (skipped(cx, cy))
+				return;
+			double zx = 0, zy = 0;
+			int n = 0;
+			while (n < longest && zx * zx + zy * zy < 4) {
+				double t = zx * zx - zy * zy + cx;
+				zy = 2 * zx * zy + cy;
+				zx = t;
+				orbit.x[n] = zx;
+				orbit.y[n] = zy;
+				n++;
+			}
+			if (zx * zx + zy * zy < 4)
+				return;
+			orbit.iterations = n;
+			bool counted = false;
+			for (int c = 0; c < CHANNELS; c++)
+				counted = counted || inBand(n, c);
+			if (!counted)
+				return;
+			int px, py;
+			for (int i = 0; i < n; i++)
+				orbit.weight += pixel(orbit.x[i], orbit.y[i], px, py);
+		}
+
+		// in doubles, where a float bin in the thousands would round away the 1e-4 or so a long orbit's
+		// 1 / weight adds
+		void splat(const Orbit& orbit, double amount) {
+			double add[CHANNELS];
+			for (int c = 0; c < CHANNELS; c++)
+				add[c] = inBand(orbit.iterations, c) ? amount : 0.0;
+			int px, py;
+			for (int i = 0; i < orbit.iterations; i++) {
+				if (!pixel(orbit.x[i], orbit.y[i], px, py))
+					continue;
+				// the channels of a pixel lie together, a Nebulabrot orbit adds to all of them at once
+				double* bin = &histogram[((size_t)py * options.width + px) * CHANNELS];
+				for (int c = 0; c < CHANNELS; c++)
+					bin[c] += add[c];
+			}
+		}
+
+		void report(long long done, std::atomic<long long>& progress) {
+			if (done % PROGRESS_INTERVAL != PROGRESS_INTERVAL - 1)
+				return;
+			long long all = progress += PROGRESS_INTERVAL;
+			if (printing)
+				std::cout << "\rSampled " << all * 100 / options.samples << "%" << std::flush;
+		}
+
+		const BuddhabrotOptions& options;
+		std::mt19937_64 random;
+		std::uniform_real_distribution<double> uniform;
+		std::vector<double>& histogram;
+		bool printing;
+		int longest;
+		Orbit current, proposal;
+	};
+}
+
+// each channel scaled so that all but its brightest few pixels fit, with a square root so the faint orbits
+// far from the set still show
+static void toneMap(const std::vector<double>& histogram, int pixels, unsigned char* rgb) {
+	for (int c = 0; c < CHANNELS; c++) {
+		std::vector<double> values;
+		for (int i = 0; i < pixels; i++) {
+			if (histogram[(size_t)i * CHANNELS + c] > 0)
+				values.push_back(histogram[(size_t)i * CHANNELS + c]);
+		}
+		double level = 1;
+		if (!values.empty()) {
+			auto bright = values.begin() + (values.size() - 1) * 999 / 1000;
+			std::nth_element(values.begin(), bright, values.end());
+			level = *bright;
+		}
+		for (int i = 0; i < pixels; i++) {
+			double v = sqrt(histogram[(size_t)i * CHANNELS + c] / level);
+			rgb[(size_t)i * 3 + c] = (unsigned char)(std::min(v, 1.0) * 255 + 0.5);
+		}
+	}
+}
+
+BuddhabrotStats renderBuddhabrot(const BuddhabrotOptions& options, ThreadPool& pool, unsigned char* rgb) {
+	int chains = (int)pool.size();
+	int pixels = options.width * options.height;
+	std::vector<std::vector<double>> histograms(chains);
+	std::atomic<long long> progress{ 0 }, accepted{ 0 };
+	bool quiet = options.file.empty();
+
+	auto start = std::chrono::steady_clock::now();
+	pool.parallelFor(chains, [&](int chain) {
+		// made by the thread that fills it, so on a machine with NUMA nodes it is on that thread's node
+		histograms[chain].assign((size_t)pixels * CHANNELS, 0.0);
+		long long samples = options.samples / chains + (chain < options.samples % chains ? 1 : 0);
+		Chain sampler(options, 0x9E3779B97F4A7C15ull * (chain + 1), histograms[chain], chain == 0 && !quiet);
+		accepted += sampler.run(samples, progress);
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (!quiet)
+		std::cout << "\rSampled 100%" << std::endl;
+
+	// every histogram into the first, a band of rows at a time
+	pool.parallelFor(options.height, [&](int row) {
+		size_t from = (size_t)row * options.width * CHANNELS, to = from + (size_t)options.width * CHANNELS;
+		for (int chain = 1; chain < chains; chain++) {
+			for (size_t i = from; i < to; i++)
+				histograms[0][i] += histograms[chain][i];
+		}
+	});
+	toneMap(histograms[0], pixels, rgb);
+	return { options.samples / seconds, options.metropolis ? (double)accepted / options.samples : 0.0 };
+}
+
+int exportBuddhabrot(const BuddhabrotOptions& options) {
+	if (options.width <= 0 || options.height <= 0 || options.samples <= 0) {
+		std::cout << "Invalid Buddhabrot size or sample count" << std::endl;
+		return 1;
+	}
+	for (const BuddhabrotBand& band : options.bands) {
+		if (band.minIterations < 0 || band.maxIterations < band.minIterations) {
+			std::cout << "Invalid Buddhabrot iteration band " << band.minIterations << "-" << band.maxIterations << std::endl;
+			return 1;
+		}
+	}
+	ThreadPool pool(options.threads);
+	std::vector<unsigned char> rgb((size_t)options.width * options.height * 3);
+	BuddhabrotStats stats = renderBuddhabrot(options, pool, rgb.data());
+
+	std::ofstream file(options.file, std::ios::binary);
+	std::string png = encodePng(rgb.data(), options.width, options.height);
+	file.write(png.data(), png.size());
+	if (!file) {
+		std::cout << "Could not write " << options.file << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << options.file << ", " << stats.samplesPerSecond / 1e6 << " million samples a second on " << pool.size()
+		<< " threads";
+	if (options.metropolis)
+		std::cout << ", " << stats.acceptance * 100 << "% of proposals accepted";
+	std::cout << std::endl;
+	return 0;
+}
+
+void benchmarkBuddhabrot(const BuddhabrotOptions& options) {
+	BuddhabrotOptions quiet = options;
+	quiet.file.clear();
+	std::vector<unsigned char> rgb((size_t)options.width * options.height * 3);
+	unsigned int hardware = std::max(std::thread::hardware_concurrency(), 1u);
+	double oneThread = 0;
+	for (unsigned int threads = 1;; threads = std::min(threads * 2, hardware)) {
+		ThreadPool pool(threads);
+		BuddhabrotStats stats = renderBuddhabrot(quiet, pool, rgb.data());
+		if (threads == 1)
+			oneThread = stats.samplesPerSecond;
+		std::cout << threads << " threads: " << stats.samplesPerSecond / 1e6 << " million samples a second, "
+			<< stats.samplesPerSecond / oneThread << "x one thread" << std::endl;
+		if (threads == hardware)
+			break;
+	}
+}
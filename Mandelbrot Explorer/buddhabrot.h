@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+#include "threadPool.h"
+
+// Buddhabrot images of the Mandelbrot set: how often the orbits of escaping points pass through each pixel,
+// rather than a count per pixel of its own orbit. every channel counts only the orbits whose escape took a
+// number of iterations in its band, which with bands such as 5000, 500 and 50 is the Nebulabrot coloring:
+// red from the long orbits, blue from the short ones. the same band in all three gives a grey Buddhabrot
+struct BuddhabrotBand {
+	int minIterations, maxIterations;
+};
+
+struct BuddhabrotOptions {
+	std::string file; // the PNG to write
+	// as in the explorer, both axes span [-scale, scale] around the center
+	double centerX = -0.4, centerY = 0.0;
+	double scale = 1.4;
+	int width = 1024, height = 1024;
+	long long samples = 50000000; // c values tried, over all threads
+	BuddhabrotBand bands[3] = { { 0, 5000 }, { 0, 500 }, { 0, 50 } }; // red, green, blue
+	// c drawn by Metropolis-Hastings, which spends the samples near the boundary where the orbits that
+	// cross the view come from. otherwise c is drawn uniformly, which finds them far less often
+	bool metropolis = true;
+	unsigned int threads = 0;
+};
+
+struct BuddhabrotStats {
+	double samplesPerSecond;
+	double acceptance; // proposals the chains moved to, 0 without Metropolis-Hastings
+};
+
+// every thread of pool runs its own chain into its own histogram, and the histograms are only added up
+// once all are done, so the threads share nothing while they sample. rgb is top-down
+BuddhabrotStats renderBuddhabrot(const BuddhabrotOptions& options, ThreadPool& pool, unsigned char* rgb);
+
+// renders options and writes options.file
+int exportBuddhabrot(const BuddhabrotOptions& options);
+
+// renders options on 1, 2, 4 and so on up to every hardware thread, and prints the samples a second of
+// each and how they scale over one thread
+void benchmarkBuddhabrot(const BuddhabrotOptions& options);
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <climits>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// register machine for user formulas, compiled by formulaCompiler.cpp. every register holds one real
+// value per pixel of a batch, and every instruction runs over the whole batch, so the cost of decoding an
+// instruction is shared by all of its pixels and the lane loops vectorise.
+// registers 0 to 3 hold Re z, Im z, Re c and Im c, the constants follow, then the temporaries
+
+enum class FormulaOp : uint8_t {
+	ADD,
+	SUB,
+	MUL,
+	DIV,
+	NEG,
+	ABS,
+	// leaves, which never appear as instructions
+	CONSTANT,
+	Z_RE,
+	Z_IM,
+	C_RE,
+	C_IM
+};
+
+static const int Z_RE_REGISTER = 0, Z_IM_REGISTER = 1, C_RE_REGISTER = 2, C_IM_REGISTER = 3;
+// enough for any formula that fits on a command line, and small enough for a batch to stay in L1
+static const int MAX_REGISTERS = 128;
+
+struct Instruction {
+	FormulaOp op;
+	uint8_t dst, a, b; // b is unused by NEG and ABS
+};
+
+struct Bytecode {
+	std::vector<double> constants; // loaded into the registers after c
+	std::vector<Instruction> code;
+	int registers = 4;
+	int outRe = Z_RE_REGISTER, outIm = Z_IM_REGISTER; // z' once the code has run
+};
+
+// a kernel with the interface of FormulaKernel that runs bytecode. a row runs LANES pixels in lockstep,
+// and as in fixed128.cpp's lanes a pixel that finishes hands its lane to the next one of the row
+template <typename Real, bool PERIODIC>
+class BytecodeKernel {
+public:
+	static const int LANES = 16;
+
+	BytecodeKernel(const Bytecode& bytecode, bool julia, double juliaX, double juliaY)
+		: bytecode(&bytecode), julia(julia), juliaX((Real)juliaX), juliaY((Real)juliaY) {}
+
+	int operator()(double px, double py, int maxIterations, bool& periodic) const {
+		int iterations;
+		run<1>(&px, py, 1, maxIterations, &iterations, &periodic);
+		return iterations;
+	}
+
+	int operator()(double px, double py, int maxIterations) const {
+		bool unused;
+		return (*this)(px, py, maxIterations, unused);
+	}
+
+	// count pixels of one row, at real parts px and imaginary part py. periodic may be null
+	void row(const double* px, double py, int count, int maxIterations, int* iterations, bool* periodic) const {
+		run<LANES>(px, py, count, maxIterations, iterations, periodic);
+	}
+
+private:
+	template <int N>
+	void execute(Real (*reg)[N]) const {
+		for (const Instruction& in : bytecode->code) {
+			Real* d = reg[in.dst];
+			const Real* a = reg[in.a];
+			const Real* b = reg[in.b];
+			switch (in.op) {
+			case FormulaOp::ADD: for (int l = 0; l < N; l++) d[l] = a[l] + b[l]; break;
+			case FormulaOp::SUB: for (int l = 0; l < N; l++) d[l] = a[l] - b[l]; break;
+			case FormulaOp::MUL: for (int l = 0; l < N; l++) d[l] = a[l] * b[l]; break;
+			case FormulaOp::DIV: for (int l = 0; l < N; l++) d[l] = a[l] / b[l]; break;
+			case FormulaOp::NEG: for (int l = 0; l < N; l++) d[l] = -a[l]; break;
+			case FormulaOp::ABS: for (int l = 0; l < N; l++) d[l] = a[l] < 0 ? -a[l] : a[l]; break;
+			default: break;
+			}
+		}
+	}
+
+	template <int N>
+	void run(const double* px, double py, int count, int maxIterations, int* iterations, bool* periodic) const {
+		alignas(64) Real reg[MAX_REGISTERS][N];
+		for (size_t k = 0; k < bytecode->constants.size(); k++)
+			for (int l = 0; l < N; l++)
+				reg[4 + k][l] = (Real)bytecode->constants[k];
+		const Real tolerance = (Real)(sizeof(Real) < sizeof(double) ? 1e-6 : 1e-13);
+
+		int pixel[N], counts[N], checkInterval[N];
+		bool settled[N];
+		Real savedX[N], savedY[N];
+		int next = 0;
+		auto start = [&](int l) {
+			pixel[l] = next < count ? next++ : -1;
+			// an idle lane iterates 0, which stays put
+			Real x = pixel[l] < 0 ? 0 : (Real)px[pixel[l]], y = pixel[l] < 0 ? 0 : (Real)py;
+			reg[Z_RE_REGISTER][l] = x;
+			reg[Z_IM_REGISTER][l] = y;
+			reg[C_RE_REGISTER][l] = julia && pixel[l] >= 0 ? juliaX : x;
+			reg[C_IM_REGISTER][l] = julia && pixel[l] >= 0 ? juliaY : y;
+			// an idle lane's count never reaches the cap, so it never holds up the batch
+			counts[l] = pixel[l] < 0 ? INT_MIN / 2 : 1;
+			settled[l] = false;
+			savedX[l] = x;
+			savedY[l] = y;
+			checkInterval[l] = 8;
+		};
+		for (int l = 0; l < N; l++)
+			start(l);
+
+		bool finished = true;
+		while (true) {
+			if (finished) {
+				int active = 0;
+				for (int l = 0; l < N; l++) {
+					// the same test as FormulaKernel's loop, and a lane that picks up a pixel checks it straight away
+					while (pixel[l] >= 0) {
+						Real x = reg[Z_RE_REGISTER][l], y = reg[Z_IM_REGISTER][l];
+						if (!settled[l] && counts[l] < maxIterations && x * x + y * y < 4)
+							break;
+						iterations[pixel[l]] = settled[l] ? maxIterations : counts[l];
+						if (periodic)
+							periodic[pixel[l]] = settled[l];
+						start(l);
+					}
+					active += pixel[l] >= 0;
+				}
+				if (active == 0)
+					return;
+			}
+
+			execute<N>(reg);
+			// branch free over the lanes, the lanes are only walked one by one once one of them is done
+			int done = 0;
+			const Real* outRe = reg[bytecode->outRe];
+			const Real* outIm = reg[bytecode->outIm];
+			Real x[N], y[N];
+			for (int l = 0; l < N; l++) {
+				x[l] = outRe[l];
+				y[l] = outIm[l];
+			}
+			for (int l = 0; l < N; l++) {
+				reg[Z_RE_REGISTER][l] = x[l];
+				reg[Z_IM_REGISTER][l] = y[l];
+				counts[l]++;
+				done |= (int)!(x[l] * x[l] + y[l] * y[l] < 4) | (int)(counts[l] >= maxIterations);
+			}
+			if (PERIODIC) {
+				for (int l = 0; l < N; l++) {
+					// Brent's method, as in FormulaKernel
+					if (pixel[l] >= 0 && fabs(x[l] - savedX[l]) < tolerance && fabs(y[l] - savedY[l]) < tolerance) {
+						settled[l] = true;
+						done = 1;
+					}
+					if (counts[l] % checkInterval[l] == 0) {
+						savedX[l] = x[l];
+						savedY[l] = y[l];
+						checkInterval[l] *= 2;
+					}
+				}
+			}
+			finished = done != 0;
+		}
+	}
+
+	const Bytecode* bytecode;
+	bool julia;
+	Real juliaX, juliaY;
+};
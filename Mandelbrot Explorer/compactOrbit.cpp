@@ -0,0 +1,53 @@
+#include "compactOrbit.h"
+
+static int64_t ulpsBetween(double from, double to) {
+	int64_t a, b;
+	memcpy(&a, &from, sizeof(a));
+	memcpy(&b, &to, sizeof(b));
+	return b - a;
+}
+
+CompactOrbit::Correction CompactOrbit::Encoder::add(double zr, double zi) {
+	Correction correction = { WAYPOINT, WAYPOINT };
+	if (count % BLOCK != 0) {
+		double pr = lastR, pi = lastI;
+		orbitStep(pr, pi, cr, ci);
+		int64_t r = ulpsBetween(pr, zr), i = ulpsBetween(pi, zi);
+		if (r > WAYPOINT && r <= INT8_MAX && i > WAYPOINT && i <= INT8_MAX)
+			correction = { (int8_t)r, (int8_t)i };
+	}
+	lastR = zr;
+	lastI = zi;
+	count++;
+	return correction;
+}
+
+void CompactOrbit::Encoder::resume(int length, double zr, double zi) {
+	count = length;
+	lastR = zr;
+	lastI = zi;
+}
+
+CompactOrbit::CompactOrbit(double cr, double ci, std::vector<Correction> steps, std::vector<Waypoint> points)
+	: cr(cr), ci(ci), corrections(std::move(steps)), waypoints(std::move(points)), encoder(cr, ci) {
+	for (size_t w = 0; w < waypoints.size(); w++) {
+		if (waypoints[w].position % BLOCK == 0)
+			blocks.push_back((int)w);
+	}
+	if (!corrections.empty()) {
+		Reader last(*this);
+		last.seek(length() - 1);
+		encoder.resume(length(), last.zr, last.zi);
+	}
+}
+
+void CompactOrbit::push(double zr, double zi) {
+	Correction correction = encoder.add(zr, zi);
+	corrections.push_back(correction);
+	if (correction.r != WAYPOINT)
+		return;
+	int n = length() - 1;
+	if (n % BLOCK == 0)
+		blocks.push_back((int)waypoints.size());
+	waypoints.push_back({ n, zr, zi });
+}
@@ -0,0 +1,192 @@
+#include "dziExport.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string.h>
+#include <vector>
+
+#include "formula.h"
+#include "pngEncode.h"
+#include "threadPool.h"
+
+static void makeDirectory(const std::string& path) {
+#ifdef _WIN32
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+// averages two rows of a level into one row of the next coarser level. the last column or row of an
+// odd sized level has no partner and is averaged with itself.
+static void downsampleRows(const unsigned char* a, const unsigned char* b, int sourceWidth, int width, unsigned char* out) {
+	for (int x = 0; x < width; x++) {
+		int x0 = 2 * x * 3;
+		int x1 = (2 * x + 1 < sourceWidth ? 2 * x + 1 : 2 * x) * 3;
+		for (int c = 0; c < 3; c++)
+			out[x * 3 + c] = (unsigned char)((a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) / 4);
+	}
+}
+
+class PyramidWriter {
+public:
+	PyramidWriter(const std::string& directory, int width, int height, int tileSize, ThreadPool& pool)
+		: directory(directory), tileSize(tileSize), pool(pool) {
+		// level 0 is 1x1, the last level is full resolution
+		std::vector<Level> coarseToFine;
+		while (true) {
+			Level level;
+			level.width = width;
+			level.height = height;
+			coarseToFine.insert(coarseToFine.begin(), level);
+			if (width == 1 && height == 1)
+				break;
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+		}
+		levels = coarseToFine;
+		for (size_t i = 0; i < levels.size(); i++) {
+			Level& level = levels[i];
+			level.strip.resize((size_t)tileSize * level.width * 3);
+			level.pairRow.resize((size_t)level.width * 3);
+			if (i > 0)
+				level.downsampledRow.resize((size_t)levels[i - 1].width * 3);
+			makeDirectory(directory + "/" + std::to_string(i));
+		}
+	}
+
+	int finestLevel() const { return (int)levels.size() - 1; }
+
+	void pushRow(int levelIndex, const unsigned char* row) {
+		Level& level = levels[levelIndex];
+		int r = level.rowsReceived++;
+		memcpy(level.strip.data() + (size_t)level.stripRows * level.width * 3, row, (size_t)level.width * 3);
+		level.stripRows++;
+		if (level.stripRows == tileSize || level.rowsReceived == level.height)
+			flushStrip(levelIndex);
+
+		if (levelIndex == 0)
+			return;
+		// pair rows up and hand the average to the next coarser level
+		int coarserWidth = levels[levelIndex - 1].width;
+		if (r % 2 == 0 && r != level.height - 1) {
+			memcpy(level.pairRow.data(), row, (size_t)level.width * 3);
+			return;
+		}
+		const unsigned char* first = r % 2 == 0 ? row : level.pairRow.data();
+		downsampleRows(first, row, level.width, coarserWidth, level.downsampledRow.data());
+		pushRow(levelIndex - 1, level.downsampledRow.data());
+	}
+
+	// waits for all outstanding tile writes
+	void finish() {
+		while (!pending.empty()) {
+			pending.front().get();
+			pending.pop_front();
+		}
+	}
+
+private:
+	struct Level {
+		int width = 0, height = 0;
+		int rowsReceived = 0;
+		std::vector<unsigned char> strip; // the tile row currently being filled
+		int stripRows = 0;
+		std::vector<unsigned char> pairRow; // even row waiting for its odd partner
+		std::vector<unsigned char> downsampledRow;
+	};
+
+	// cuts the strip into tiles and encodes them in parallel. each job takes a copy of its tile so the
+	// strip can be refilled straight away; the number of tiles in flight is capped to bound memory.
+	void flushStrip(int levelIndex) {
+		Level& level = levels[levelIndex];
+		int tileRow = (level.rowsReceived - 1) / tileSize;
+		for (int x0 = 0; x0 < level.width; x0 += tileSize) {
+			int tileWidth = level.width - x0 < tileSize ? level.width - x0 : tileSize;
+			int tileHeight = level.stripRows;
+			std::vector<unsigned char> tile((size_t)tileWidth * tileHeight * 3);
+			for (int row = 0; row < tileHeight; row++)
+				memcpy(tile.data() + (size_t)row * tileWidth * 3, level.strip.data() + ((size_t)row * level.width + x0) * 3, (size_t)tileWidth * 3);
+
+			std::string path = directory + "/" + std::to_string(levelIndex) + "/" + std::to_string(x0 / tileSize) + "_" + std::to_string(tileRow) + ".png";
+			while (pending.size() >= 4 * (size_t)pool.size()) {
+				pending.front().get();
+				pending.pop_front();
+			}
+			pending.push_back(pool.submit([tile, tileWidth, tileHeight, path]() {
+				std::string png = encodePng(tile.data(), tileWidth, tileHeight);
+				std::ofstream file(path, std::ios::binary);
+				file.write(png.data(), png.size());
+			}));
+		}
+		level.stripRows = 0;
+	}
+
+	std::string directory;
+	int tileSize;
+	ThreadPool& pool;
+	std::vector<Level> levels;
+	std::deque<std::future<void>> pending;
+};
+
+int exportDzi(const DziOptions& options) {
+	if (options.width < 1 || options.height < 1 || options.tileSize < 1 || options.maxIterations < 1) {
+		std::cout << "Invalid DZI export size" << std::endl;
+		return -1;
+	}
+
+	std::string directory = options.name + "_files";
+	makeDirectory(directory);
+
+	std::ofstream descriptor(options.name + ".dzi");
+	if (!descriptor) {
+		std::cout << "Could not write " << options.name << ".dzi" << std::endl;
+		return -1;
+	}
+	descriptor << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		<< "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"" << options.tileSize
+		<< "\" Overlap=\"0\" Format=\"png\">\n"
+		<< "  <Size Width=\"" << options.width << "\" Height=\"" << options.height << "\"/>\n"
+		<< "</Image>\n";
+	descriptor.close();
+
+	ThreadPool pool(options.threads);
+	PyramidWriter pyramid(directory, options.width, options.height, options.tileSize, pool);
+
+	double pixelSize = 2.0 * options.scale / options.height;
+	std::vector<unsigned char> strip((size_t)options.tileSize * options.width * 3);
+	std::vector<double> cr(options.width);
+	for (int px = 0; px < options.width; px++)
+		cr[px] = options.centerX + (px + 0.5 - options.width * 0.5) * pixelSize;
+	int tileRows = (options.height + options.tileSize - 1) / options.tileSize;
+	for (int tileRow = 0; tileRow < tileRows; tileRow++) {
+		int firstRow = tileRow * options.tileSize;
+		int rows = options.height - firstRow < options.tileSize ? options.height - firstRow : options.tileSize;
+
+		withKernel(options.variant, [&](const auto& kernel) {
+			pool.parallelFor(rows, [&](int r) {
+				double ci = options.centerY + (options.height * 0.5 - (firstRow + r) - 0.5) * pixelSize;
+				unsigned char* row = strip.data() + (size_t)r * options.width * 3;
+				std::vector<int> iterations(options.width);
+				kernel.row(cr.data(), ci, options.width, options.maxIterations, iterations.data(), nullptr);
+				for (int px = 0; px < options.width; px++)
+					colorIterations(iterations[px], options.maxIterations, row + px * 3);
+			});
+		});
+
+		for (int r = 0; r < rows; r++)
+			pyramid.pushRow(pyramid.finestLevel(), strip.data() + (size_t)r * options.width * 3);
+		std::cout << "\rRendered tile row " << tileRow + 1 << " / " << tileRows << std::flush;
+	}
+	pyramid.finish();
+	std::cout << std::endl << "Wrote " << options.name << ".dzi" << std::endl;
+	return 0;
+}
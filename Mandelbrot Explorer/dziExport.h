@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+#include "formula.h"
+
+// Deep Zoom (DZI) export: renders the full resolution level tile row by tile row and builds every
+// coarser level by downsampling rows as they stream past, so memory stays at a few tile rows per level.
+// pixels are square; scale is half the height of the view in fractal space, as in the explorer.
+struct DziOptions {
+	std::string name; // writes name.dzi and name_files/
+	double centerX = 0.0, centerY = 0.0;
+	double scale = 1.0;
+	int width = 4096, height = 4096;
+	int maxIterations = 256;
+	int tileSize = 256;
+	unsigned int threads = 0;
+	KernelVariant variant;
+};
+
+int exportDzi(const DziOptions& options);
@@ -0,0 +1,171 @@
+#include "fixed128.h"
+
+#include <math.h>
+
+#include "kernel.h"
+
+Fixed128 Fixed128::fromDouble(double value) {
+	// split |value| 2^124 into its top and bottom 64 bits
+	double scaled = ldexp(fabs(value), FRACTION_BITS - 64);
+	Fixed128 result;
+	result.hi = (uint64_t)scaled;
+	result.lo = (uint64_t)ldexp(scaled - (double)result.hi, 64);
+	return value < 0 ? -result : result;
+}
+
+Fixed128 Fixed128::fromBigFixed(const BigFixed& value) {
+	// the integer limb and the top 124 bits of four fraction limbs
+	BigFixed bits = value.withPrecision(4);
+	uint64_t top = (uint64_t)bits.limb(4) << 32 | bits.limb(3);
+	uint64_t bottom = (uint64_t)bits.limb(2) << 32 | bits.limb(1);
+	Fixed128 result;
+	result.hi = top << 28 | bottom >> 36;
+	result.lo = bottom << 28 | bits.limb(0) >> 4;
+	return bits.isNegative() ? -result : result;
+}
+
+double Fixed128::toDouble() const {
+	Fixed128 magnitude = absolute(*this);
+	double value = ldexp((double)magnitude.hi, 64 - FRACTION_BITS) + ldexp((double)magnitude.lo, -FRACTION_BITS);
+	return isNegative() ? -value : value;
+}
+
+namespace {
+	// pixels are iterated a few at a time in lockstep. the 64 bit multiplies of one pixel depend on each
+	// other, but those of different pixels don't, so interleaving lanes keeps the multiplier busy. a lane
+	// that finishes picks up the next pixel of the row straight away.
+	const int LANES = 4;
+
+	struct Lane {
+		Fixed128 cx, cy, zx, zy;
+		double dx, dy; // dz/dc times the pixel spacing, for distance estimates
+		int count;
+		int px; // -1 once the row has no pixels left for this lane
+	};
+
+	// |z| >= 2 on either axis has escaped already, and checking it first keeps the squares below 8
+	const uint64_t TWO = 2ULL << (Fixed128::FRACTION_BITS - 64);
+	const uint64_t FOUR = 4ULL << (Fixed128::FRACTION_BITS - 64);
+
+	bool escaped(const Fixed128& zx, const Fixed128& zy, Fixed128& xx, Fixed128& yy) {
+		if (absolute(zx).hi >= TWO || absolute(zy).hi >= TWO)
+			return true;
+		xx = zx * zx;
+		yy = zy * zy;
+		// both squares are below 4, so their unsigned sum can't wrap
+		return (xx + yy).hi >= FOUR;
+	}
+
+	// toDouble without the ldexps, close enough for the derivative: the high word is the signed part of the
+	// two's complement value and the low word adds on unsigned
+	double approximate(const Fixed128& value) {
+		const double HIGH = 1.0 / (double)(1ULL << (Fixed128::FRACTION_BITS - 64));
+		const double LOW = HIGH / 18446744073709551616.0;
+		return (double)(int64_t)value.hi * HIGH + (double)value.lo * LOW;
+	}
+
+	// dz' = 2 z dz + pixelSize, with dz in pixels. z only needs a double's precision here
+	void stepDerivative(const Fixed128& zx, const Fixed128& zy, double pixelSize, double& dx, double& dy) {
+		double x = approximate(zx), y = approximate(zy);
+		double t = 2.0 * (x * dx - y * dy) + pixelSize;
+		dy = 2.0 * (x * dy + y * dx);
+		dx = t;
+	}
+
+	template <bool DISTANCE>
+	int iterate(const Fixed128& cx, const Fixed128& cy, int maxIterations, double pixelSize, float& distance) {
+		Fixed128 zx = cx, zy = cy, xx, yy;
+		double dx = pixelSize, dy = 0.0;
+		int count = 1;
+		while (count < maxIterations && !escaped(zx, zy, xx, yy)) {
+			if (DISTANCE)
+				stepDerivative(zx, zy, pixelSize, dx, dy);
+			Fixed128 xy = zx * zy;
+			zx = xx - yy + cx;
+			zy = xy + xy + cy;
+			count++;
+		}
+		if (DISTANCE)
+			distance = count < maxIterations ? (float)escapeDistance(zx.toDouble(), zy.toDouble(), dx, dy, cx.toDouble(), cy.toDouble()) : 0.0f;
+		return count;
+	}
+
+	template <bool DISTANCE>
+	void renderLanes(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations, float* distances) {
+		Fixed128 centerX = Fixed128::fromBigFixed(view.centerX), centerY = Fixed128::fromBigFixed(view.centerY);
+		double scaleX = view.scaleX.toDouble(), scaleY = view.scaleY.toDouble();
+		double pixelSize = 2.0 * scaleY / view.height;
+
+		pool.parallelFor(view.height, [&](int py) {
+			Fixed128 cy = centerY + Fixed128::fromDouble(((view.height - py - 0.5) / view.height * 2.0 - 1.0) * scaleY);
+			int* row = iterations + (size_t)py * view.width;
+			float* distanceRow = DISTANCE ? distances + (size_t)py * view.width : nullptr;
+			int next = 0;
+			Lane lanes[LANES];
+			auto start = [&](Lane& lane) {
+				lane.px = next < view.width ? next++ : -1;
+				if (lane.px < 0)
+					return;
+				lane.cx = centerX + Fixed128::fromDouble(((lane.px + 0.5) / view.width * 2.0 - 1.0) * scaleX);
+				lane.cy = cy;
+				lane.zx = lane.cx;
+				lane.zy = lane.cy;
+				lane.dx = pixelSize;
+				lane.dy = 0.0;
+				lane.count = 1;
+			};
+			for (Lane& lane : lanes)
+				start(lane);
+
+			int active = LANES;
+			while (active > 0) {
+				active = 0;
+				for (Lane& lane : lanes) {
+					if (lane.px < 0)
+						continue;
+					Fixed128 xx, yy;
+					if (lane.count >= maxIterations || escaped(lane.zx, lane.zy, xx, yy)) {
+						row[lane.px] = lane.count;
+						if (DISTANCE) {
+							distanceRow[lane.px] = lane.count < maxIterations ? (float)escapeDistance(lane.zx.toDouble(), lane.zy.toDouble(),
+								lane.dx, lane.dy, lane.cx.toDouble(), lane.cy.toDouble()) : 0.0f;
+						}
+						start(lane);
+						active += lane.px >= 0;
+						continue;
+					}
+					if (DISTANCE)
+						stepDerivative(lane.zx, lane.zy, pixelSize, lane.dx, lane.dy);
+					// z' = (x^2 - y^2 + cx, 2xy + cy), the same step the other kernels take
+					Fixed128 xy = lane.zx * lane.zy;
+					lane.zx = xx - yy + lane.cx;
+					lane.zy = xy + xy + lane.cy;
+					lane.count++;
+					active++;
+				}
+			}
+		});
+	}
+}
+
+bool fixed128Resolves(const DeepView& view) {
+	double scaleX = view.scaleX.toDouble(), scaleY = view.scaleY.toDouble();
+	return scaleX >= FIXED128_SCALE && scaleY >= FIXED128_SCALE
+		&& fabs(view.centerX.toDouble()) + scaleX < 4 && fabs(view.centerY.toDouble()) + scaleY < 4;
+}
+
+int fixed128Iterations(const Fixed128& cx, const Fixed128& cy, int maxIterations) {
+	float unused;
+	return iterate<false>(cx, cy, maxIterations, 0.0, unused);
+}
+
+int fixed128Distance(const Fixed128& cx, const Fixed128& cy, int maxIterations, double pixelSize, float& distance) {
+	return iterate<true>(cx, cy, maxIterations, pixelSize, distance);
+}
+
+void renderFixed128(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations, float* distances) {
+	if (distances)
+		renderLanes<true>(view, maxIterations, pool, iterations, distances);
+	else
+		renderLanes<false>(view, maxIterations, pool, iterations, nullptr);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include "perturbation.h"
+#include "threadPool.h"
+
+// 128 bit two's complement fixed point with 4 integer bits (Q4.124), held as two 64 bit words. resolves
+// 2^-124 (about 5e-38), so views down to FIXED128_SCALE can be iterated directly instead of against a
+// reference orbit: no glitches, and every pixel is computed the same way, which makes it the ground truth
+// that the perturbation renderer is checked against.
+struct Fixed128 {
+	static const int FRACTION_BITS = 124;
+
+	uint64_t hi, lo;
+
+	static Fixed128 fromDouble(double value);
+	// truncates to 124 fraction bits; |value| must be below 8
+	static Fixed128 fromBigFixed(const BigFixed& value);
+	double toDouble() const;
+
+	bool isNegative() const { return hi >> 63 != 0; }
+};
+
+// views smaller than this have pixels closer together than Fixed128 resolves well
+static const double FIXED128_SCALE = 1e-30;
+
+// 64 x 64 -> 128 bit multiply, with whichever primitive the compiler has
+inline uint64_t multiply64(uint64_t a, uint64_t b, uint64_t& high) {
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)a * b;
+	high = (uint64_t)(product >> 64);
+	return (uint64_t)product;
+#elif defined(_MSC_VER) && defined(_M_X64)
+	return _umul128(a, b, &high);
+#else
+	// 32 bit targets: four 32 x 32 partial products
+	uint64_t aLow = (uint32_t)a, aHigh = a >> 32, bLow = (uint32_t)b, bHigh = b >> 32;
+	uint64_t low = aLow * bLow, middle1 = aHigh * bLow, middle2 = aLow * bHigh;
+	uint64_t middle = (low >> 32) + (uint32_t)middle1 + (uint32_t)middle2;
+	high = aHigh * bHigh + (middle1 >> 32) + (middle2 >> 32) + (middle >> 32);
+	return (middle << 32) | (uint32_t)low;
+#endif
+}
+
+inline Fixed128 operator+(const Fixed128& a, const Fixed128& b) {
+	Fixed128 result;
+	result.lo = a.lo + b.lo;
+	result.hi = a.hi + b.hi + (result.lo < a.lo);
+	return result;
+}
+
+inline Fixed128 operator-(const Fixed128& a, const Fixed128& b) {
+	Fixed128 result;
+	result.lo = a.lo - b.lo;
+	result.hi = a.hi - b.hi - (a.lo < b.lo);
+	return result;
+}
+
+inline Fixed128 operator-(const Fixed128& value) {
+	Fixed128 zero = { 0, 0 };
+	return zero - value;
+}
+
+inline Fixed128 absolute(const Fixed128& value) {
+	return value.isNegative() ? -value : value;
+}
+
+// a b for a product within (-8, 8): bits 124 to 251 of the 256 bit product, rounded towards -infinity.
+// the words are multiplied as unsigned and then corrected for the signs, which avoids negating either side
+inline Fixed128 operator*(const Fixed128& a, const Fixed128& b) {
+	uint64_t p0h, p1h, p2h, p3h;
+	multiply64(a.lo, b.lo, p0h);
+	uint64_t p1l = multiply64(a.lo, b.hi, p1h);
+	uint64_t p2l = multiply64(a.hi, b.lo, p2h);
+	uint64_t p3l = multiply64(a.hi, b.hi, p3h);
+
+	// sum the partial products column by column, word 1 then word 2, carrying upwards
+	uint64_t w1 = p0h + p1l;
+	uint64_t carry = w1 < p0h;
+	w1 += p2l;
+	carry += w1 < p2l;
+	uint64_t w2 = p1h + carry;
+	carry = w2 < carry;
+	w2 += p2h;
+	carry += w2 < p2h;
+	w2 += p3l;
+	carry += w2 < p3l;
+	uint64_t w3 = p3h + carry;
+
+	// as unsigned, a negative a stands for a + 2^128, which adds b 2^128 to the product; take it back off
+	// the top two words, and the same for b
+	uint64_t aSign = 0 - (a.hi >> 63), bSign = 0 - (b.hi >> 63);
+	uint64_t subtractLo = (b.lo & aSign) + (a.lo & bSign);
+	uint64_t subtractHi = (b.hi & aSign) + (a.hi & bSign) + (subtractLo < (b.lo & aSign));
+	w3 -= subtractHi + (w2 < subtractLo);
+	w2 -= subtractLo;
+
+	Fixed128 result;
+	result.lo = (w1 >> 60) | (w2 << 4);
+	result.hi = (w2 >> 60) | (w3 << 4);
+	return result;
+}
+
+// whether every pixel of the view can be iterated in Fixed128: not too deep, and inside |c| < 4
+bool fixed128Resolves(const DeepView& view);
+
+// iterations of a single point, counted the way the other kernels count. |c| must be below 4
+int fixed128Iterations(const Fixed128& cx, const Fixed128& cy, int maxIterations);
+// the same count, and the distance estimate in pixels of the given size (0 if c didn't escape)
+int fixed128Distance(const Fixed128& cx, const Fixed128& cy, int maxIterations, double pixelSize, float& distance);
+
+// writes an iteration count per pixel, top row first, iterating every pixel directly in Fixed128.
+// only for views that fixed128Resolves. distances, if given, gets a distance estimate per pixel as
+// fixed128Distance computes it
+void renderFixed128(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations, float* distances = nullptr);
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// extended exponent float: a double mantissa in [1, 2) with a separate 64 bit exponent, value = m 2^e.
+// reaches far below the 1e-308 limit of double, for perturbation deltas and view scales in very deep
+// zooms. normalising only rewrites the exponent bits of the mantissa rather than calling frexp/ldexp, and
+// products of two mantissas need at most one halving, which keeps the arithmetic close to a few doubles.
+// the operators are free functions so doubles mix in on either side.
+struct FloatExp {
+	static const int64_t ZERO_EXPONENT = -(1LL << 60);
+
+	double m;
+	int64_t e;
+
+	FloatExp() : m(0), e(ZERO_EXPONENT) {}
+	FloatExp(double value) : m(value), e(0) { normalize(); }
+	FloatExp(double mantissa, int64_t exponent) : m(mantissa), e(exponent) { normalize(); }
+
+	// parses a decimal such as "1.5e-2000", which strtod would flush to zero, or the exact form toString
+	// writes past double's range, a decimal mantissa with a binary exponent such as "1.25p-4000"
+	static bool parse(const std::string& text, FloatExp& out) {
+		size_t binary = text.find_first_of("pP");
+		if (binary != std::string::npos) {
+			char* end;
+			double mantissa = strtod(text.substr(0, binary).c_str(), &end);
+			if (*end != '\0' || binary == 0)
+				return false;
+			long long exponent = strtoll(text.c_str() + binary + 1, &end, 10);
+			if (*end != '\0')
+				return false;
+			out = FloatExp(mantissa, exponent);
+			return true;
+		}
+		// anything a double holds is read exactly by strtod
+		char* end;
+		double direct = strtod(text.c_str(), &end);
+		if (*end == '\0' && !text.empty() && isnormal(direct)) {
+			out = FloatExp(direct);
+			return true;
+		}
+		size_t split = text.find_first_of("eE");
+		double mantissa = strtod(text.substr(0, split).c_str(), &end);
+		if (*end != '\0' || split == 0)
+			return false;
+		long long exponent10 = 0;
+		if (split != std::string::npos) {
+			exponent10 = strtoll(text.c_str() + split + 1, &end, 10);
+			if (*end != '\0')
+				return false;
+		}
+		// 10^k = 2^(k log2 10), split into an integer power of two and a remaining factor
+		double log2Value = exponent10 * 3.321928094887362347870319429489;
+		double whole = floor(log2Value);
+		out = FloatExp(mantissa * exp2(log2Value - whole), (int64_t)whole);
+		return true;
+	}
+
+	// text that parse() turns back into exactly this value: 17 significant digits round trip any double
+	std::string toString() const {
+		char text[64];
+		if (isZero() || (e > -1000 && e < 1000))
+			snprintf(text, sizeof(text), "%.17g", toDouble());
+		else
+			snprintf(text, sizeof(text), "%.17gp%lld", m, (long long)e);
+		return text;
+	}
+
+	void normalize() {
+		uint64_t bits;
+		memcpy(&bits, &m, sizeof(bits));
+		int64_t biased = (int64_t)(bits >> 52 & 0x7ff);
+		if (biased == 0) {
+			if (m == 0) {
+				e = ZERO_EXPONENT;
+				return;
+			}
+			// subnormal, bring it into the normal range first
+			m *= 18014398509481984.0; // 2^54
+			e -= 54;
+			memcpy(&bits, &m, sizeof(bits));
+			biased = (int64_t)(bits >> 52 & 0x7ff);
+		}
+		e += biased - 1023;
+		bits = (bits & ~(0x7ffULL << 52)) | (1023ULL << 52);
+		memcpy(&m, &bits, sizeof(bits));
+	}
+
+	bool isZero() const { return m == 0; }
+
+	double toDouble() const {
+		if (e < -1100)
+			return 0;
+		if (e > 1100)
+			return m * INFINITY;
+		return ldexp(m, (int)e);
+	}
+
+	// 2^exponent as a double, for exponents in the normal range
+	static double exp2i(int64_t exponent) {
+		uint64_t bits = (uint64_t)(exponent + 1023) << 52;
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+};
+
+inline FloatExp operator-(const FloatExp& value) {
+	return FloatExp(-value.m, value.e);
+}
+
+inline FloatExp operator*(const FloatExp& a, const FloatExp& b) {
+	FloatExp result;
+	result.m = a.m * b.m;
+	if (result.m == 0)
+		return result;
+	// both mantissas are in [1, 2), so the product only ever needs one halving
+	result.e = a.e + b.e;
+	if (fabs(result.m) >= 2) {
+		result.m *= 0.5;
+		result.e++;
+	}
+	return result;
+}
+
+inline FloatExp operator/(const FloatExp& a, const FloatExp& b) {
+	return FloatExp(a.m / b.m, a.e - b.e);
+}
+
+inline FloatExp operator+(const FloatExp& a, const FloatExp& b) {
+	const FloatExp& large = a.e >= b.e ? a : b;
+	const FloatExp& small = a.e >= b.e ? b : a;
+	int64_t shift = large.e - small.e;
+	if (shift > 63)
+		return large;
+	return FloatExp(large.m + small.m * FloatExp::exp2i(-shift), large.e);
+}
+
+inline FloatExp operator-(const FloatExp& a, const FloatExp& b) {
+	return a + -b;
+}
+
+inline bool operator<(const FloatExp& a, const FloatExp& b) {
+	return (a - b).m < 0;
+}
+
+inline bool operator>(const FloatExp& a, const FloatExp& b) {
+	return b < a;
+}
+
+inline bool operator<=(const FloatExp& a, const FloatExp& b) {
+	return !(b < a);
+}
+
+inline bool operator>=(const FloatExp& a, const FloatExp& b) {
+	return !(a < b);
+}
+
+inline FloatExp sqrt(const FloatExp& value) {
+	if (value.isZero())
+		return value;
+	// halve an even exponent, folding an odd one into the mantissa
+	int64_t odd = value.e & 1;
+	return FloatExp(sqrt(value.m * (odd ? 2.0 : 1.0)), (value.e - odd) / 2);
+}
+
+inline FloatExp fabs(const FloatExp& value) {
+	return FloatExp(fabs(value.m), value.e);
+}
+
+inline FloatExp hypot(const FloatExp& x, const FloatExp& y) {
+	return sqrt(x * x + y * y);
+}
+
+inline double toDouble(double value) {
+	return value;
+}
+
+inline double toDouble(const FloatExp& value) {
+	return value.toDouble();
+}
+
+// narrows an extended value to the delta type a kernel runs in
+template <typename Real> Real fromFloatExp(const FloatExp& value);
+
+template <> inline double fromFloatExp<double>(const FloatExp& value) {
+	return value.toDouble();
+}
+
+template <> inline FloatExp fromFloatExp<FloatExp>(const FloatExp& value) {
+	return value;
+}
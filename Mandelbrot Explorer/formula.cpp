@@ -0,0 +1,110 @@
+#include "formula.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+std::string Formula::name() const {
+	std::string base;
+	switch (kind) {
+	case FormulaKind::MULTIBROT: base = "multibrot" + std::to_string(power); break;
+	case FormulaKind::BURNING_SHIP: base = "burningship"; break;
+	case FormulaKind::TRICORN: base = "tricorn"; break;
+	case FormulaKind::CUSTOM: base = custom->text; break;
+	default: base = "mandelbrot"; break;
+	}
+	return julia ? base + " julia" : base;
+}
+
+bool parseFormula(const std::string& text, Formula& out, std::string& error) {
+	if (text == "mandelbrot") {
+		out.kind = FormulaKind::MANDELBROT;
+	}
+	else if (text == "burningship") {
+		out.kind = FormulaKind::BURNING_SHIP;
+	}
+	else if (text == "tricorn") {
+		out.kind = FormulaKind::TRICORN;
+	}
+	else if (text.compare(0, 9, "multibrot") == 0) {
+		char* end;
+		long power = strtol(text.c_str() + 9, &end, 10);
+		if (*end != '\0' || power < 2 || power > MAX_POWER) {
+			error = "multibrot takes a power from 2 to " + std::to_string(MAX_POWER);
+			return false;
+		}
+		// the Multibrot of power 2 is the Mandelbrot set, which keeps its own renderers
+		out.kind = power == 2 ? FormulaKind::MANDELBROT : FormulaKind::MULTIBROT;
+		out.power = (int)power;
+		return true;
+	}
+	else {
+		auto custom = std::make_shared<CompiledFormula>();
+		if (!compileFormula(text, *custom, error))
+			return false;
+		out.kind = FormulaKind::CUSTOM;
+		out.custom = custom;
+		return true;
+	}
+	out.power = 2;
+	return true;
+}
+
+// a GLSL double constant that keeps every bit of value
+static std::string doubleLiteral(double value) {
+	char text[64];
+	snprintf(text, sizeof(text), "%.17elf", value);
+	return text;
+}
+
+// formulaStep() for a built in formula, the same steps as formula.h
+static std::string builtinStep(const Formula& formula) {
+	std::string source = "VEC formulaStep(VEC z, VEC c) {\n";
+	switch (formula.kind) {
+	case FormulaKind::BURNING_SHIP:
+		source += "\treturn VEC(z.x * z.x - z.y * z.y, 2.0 * abs(z.x * z.y)) + c;\n";
+		break;
+	case FormulaKind::TRICORN:
+		source += "\treturn VEC(z.x * z.x - z.y * z.y, -2.0 * z.x * z.y) + c;\n";
+		break;
+	case FormulaKind::MULTIBROT:
+		source += "\tVEC p = z;\n";
+		for (int i = 1; i < formula.power; i++)
+			source += "\tp = VEC(p.x * z.x - p.y * z.y, p.x * z.y + p.y * z.x);\n";
+		source += "\treturn p + c;\n";
+		break;
+	default:
+		source += "\treturn VEC(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;\n";
+		break;
+	}
+	source += "}\n";
+	return source;
+}
+
+std::string shaderDefines(const KernelVariant& variant, bool distance) {
+	const Formula& formula = variant.formula;
+	std::string source;
+	if (variant.singlePrecision) {
+		source += "#define REAL float\n#define VEC vec2\n";
+		source += "#define PACK(z) uvec4(floatBitsToUint(z), 0u, 0u)\n";
+		source += "#define UNPACK(v) uintBitsToFloat(v.xy)\n";
+	}
+	else {
+		source += "#define REAL double\n#define VEC dvec2\n";
+		source += "#define PACK(z) uvec4(unpackDouble2x32(z.x), unpackDouble2x32(z.y))\n";
+		source += "#define UNPACK(v) dvec2(packDouble2x32(v.xy), packDouble2x32(v.zw))\n";
+	}
+
+	source += formula.kind == FormulaKind::CUSTOM ? formula.custom->glsl : builtinStep(formula);
+
+	if (formula.julia) {
+		source += "#define JULIA\n";
+		source += "const VEC JULIA_C = VEC(dvec2(" + doubleLiteral(formula.juliaX) + ", " + doubleLiteral(formula.juliaY) + "));\n";
+	}
+	if (variant.interiorCheck) {
+		source += "#define INTERIOR_CHECK\n";
+		source += variant.singlePrecision ? "const REAL TOLERANCE = 1e-6;\n" : "const REAL TOLERANCE = 1e-13lf;\n";
+	}
+	if (distance && formula.isMandelbrot() && !variant.singlePrecision)
+		source += "#define DISTANCE_ESTIMATE\n";
+	return source;
+}
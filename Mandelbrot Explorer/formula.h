@@ -0,0 +1,317 @@
+#pragma once
+
+#include <climits>
+#include <math.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+#include "formulaCompiler.h"
+#include "kernel.h"
+
+// the fractals besides the Mandelbrot set, as z' = f(z) + c iterated from z = c, or any z' = f(z, c)
+// typed in. a Julia set keeps c fixed and starts every pixel's orbit at the pixel instead, for any of them.
+// each combination of formula, power, precision and interior check gets its own kernel: a template
+// instance on the CPU and a generated variant of iterateShader.glsl on the GPU. the choice is made once
+// per render, so the inner loops have no branches for it and the Mandelbrot path runs what it always did
+enum class FormulaKind {
+	MANDELBROT,
+	MULTIBROT, // z^power + c
+	BURNING_SHIP, // (|Re z| + i |Im z|)^2 + c
+	TRICORN, // conj(z)^2 + c
+	CUSTOM // typed in, see formulaCompiler.h
+};
+
+// highest power a Multibrot kernel is generated for
+static const int MAX_POWER = 8;
+
+struct Formula {
+	FormulaKind kind = FormulaKind::MANDELBROT;
+	int power = 2; // 3 to MAX_POWER for MULTIBROT
+	bool julia = false;
+	double juliaX = 0.0, juliaY = 0.0; // the fixed c of a Julia set
+	std::shared_ptr<const CompiledFormula> custom; // for CUSTOM
+
+	// only this one has perturbation and high precision renderers, the others stop at what a double resolves
+	bool isMandelbrot() const { return kind == FormulaKind::MANDELBROT && !julia; }
+	std::string name() const;
+};
+
+// mandelbrot, multibrot<power>, burningship, tricorn, or else a formula for z' to compile. false with the
+// compiler's message if it is none of them
+bool parseFormula(const std::string& text, Formula& out, std::string& error);
+
+// everything a kernel is specialised for
+struct KernelVariant {
+	Formula formula;
+	// floats instead of doubles, for GPUs that run doubles at a fraction of the speed. they resolve views
+	// down to a scale of about 1e-5
+	bool singlePrecision = false;
+	// stops orbits that settle into a cycle, which proves the pixel is inside the set. it costs a compare
+	// per iteration and pays off in views with a lot of interior
+	bool interiorCheck = false;
+};
+
+// source inserted after the #version line of iterateShader.glsl to build this variant. distance asks for
+// the DISTANCE_ESTIMATE variant, which only exists for the Mandelbrot set in doubles and is ignored otherwise
+std::string shaderDefines(const KernelVariant& variant, bool distance = false);
+
+// one step of each built in formula, without the + c
+struct SquareStep {
+	template <typename Real>
+	static void step(Real& zx, Real& zy) {
+		Real t = zx * zx - zy * zy;
+		zy = 2 * zx * zy;
+		zx = t;
+	}
+};
+
+struct BurningShipStep {
+	template <typename Real>
+	static void step(Real& zx, Real& zy) {
+		Real t = zx * zx - zy * zy;
+		zy = 2 * fabs(zx * zy);
+		zx = t;
+	}
+};
+
+struct TricornStep {
+	template <typename Real>
+	static void step(Real& zx, Real& zy) {
+		Real t = zx * zx - zy * zy;
+		zy = -2 * zx * zy;
+		zx = t;
+	}
+};
+
+template <int POWER>
+struct PowerStep {
+	template <typename Real>
+	static void step(Real& zx, Real& zy) {
+		// POWER is known here, so the compiler unrolls this into the multiplies
+		Real px = zx, py = zy;
+		for (int i = 1; i < POWER; i++) {
+			Real t = px * zx - py * zy;
+			py = px * zy + py * zx;
+			px = t;
+		}
+		zx = px;
+		zy = py;
+	}
+};
+
+// the iteration count of a pixel, counted as mandelbrotIterations does. with PERIODIC it also reports
+// whether an orbit that hit the cap had settled into a cycle, which proves the point is inside the set
+// rather than just under-iterated
+template <typename Real, typename Step, bool JULIA, bool PERIODIC>
+struct FormulaKernel {
+	Real juliaX, juliaY;
+
+	int operator()(double px, double py, int maxIterations, bool& periodic) const {
+		Real zx = (Real)px, zy = (Real)py;
+		Real cx = JULIA ? juliaX : zx, cy = JULIA ? juliaY : zy;
+		// a float orbit only settles to within its own precision
+		const Real tolerance = (Real)(sizeof(Real) < sizeof(double) ? 1e-6 : 1e-13);
+		Real savedX = zx, savedY = zy;
+		int iterations = 1, checkInterval = 8;
+		periodic = false;
+		while (iterations < maxIterations && zx * zx + zy * zy < 4) {
+			Step::step(zx, zy);
+			zx += cx;
+			zy += cy;
+			iterations++;
+			if (PERIODIC) {
+				// Brent's method: compare against a point saved at doubling intervals
+				if (fabs(zx - savedX) < tolerance && fabs(zy - savedY) < tolerance) {
+					periodic = true;
+					return maxIterations;
+				}
+				if (iterations % checkInterval == 0) {
+					savedX = zx;
+					savedY = zy;
+					checkInterval *= 2;
+				}
+			}
+		}
+		return iterations;
+	}
+
+	int operator()(double px, double py, int maxIterations) const {
+		bool unused;
+		return (*this)(px, py, maxIterations, unused);
+	}
+
+	// count pixels of one row, at real parts px and imaginary part py. periodic may be null
+	void row(const double* px, double py, int count, int maxIterations, int* iterations, bool* periodic) const {
+		for (int i = 0; i < count; i++) {
+			bool settled;
+			iterations[i] = (*this)(px[i], py, maxIterations, settled);
+			if (periodic)
+				periodic[i] = settled;
+		}
+	}
+};
+
+// FormulaKernel with rows run LANES pixels in lockstep, for the CPU SIMD renderer. every step is the same
+// arithmetic on every lane, which the compiler turns into vector instructions, and as in BytecodeKernel a
+// pixel that finishes hands its lane to the next one of the row. the counts are the same as FormulaKernel's
+template <typename Real, typename Step, bool JULIA, bool PERIODIC>
+struct LaneKernel {
+	// a 512 bit vector of doubles, or two 256 bit ones
+	static const int LANES = 8;
+
+	Real juliaX, juliaY;
+
+	int operator()(double px, double py, int maxIterations, bool& periodic) const {
+		return FormulaKernel<Real, Step, JULIA, PERIODIC>{ juliaX, juliaY }(px, py, maxIterations, periodic);
+	}
+
+	int operator()(double px, double py, int maxIterations) const {
+		bool unused;
+		return (*this)(px, py, maxIterations, unused);
+	}
+
+	void row(const double* px, double py, int count, int maxIterations, int* iterations, bool* periodic) const {
+		const Real tolerance = (Real)(sizeof(Real) < sizeof(double) ? 1e-6 : 1e-13);
+		alignas(64) Real zx[LANES], zy[LANES], cx[LANES], cy[LANES], savedX[LANES], savedY[LANES];
+		int pixel[LANES], counts[LANES], nextCheck[LANES];
+		bool settled[LANES];
+		int next = 0;
+		auto start = [&](int l) {
+			pixel[l] = next < count ? next++ : -1;
+			// an idle lane iterates 0, which stays put, and its count never reaches the cap
+			Real x = pixel[l] < 0 ? 0 : (Real)px[pixel[l]], y = pixel[l] < 0 ? 0 : (Real)py;
+			zx[l] = savedX[l] = x;
+			zy[l] = savedY[l] = y;
+			cx[l] = JULIA && pixel[l] >= 0 ? juliaX : x;
+			cy[l] = JULIA && pixel[l] >= 0 ? juliaY : y;
+			counts[l] = pixel[l] < 0 ? INT_MIN / 2 : 1;
+			settled[l] = false;
+			nextCheck[l] = 8;
+		};
+		for (int l = 0; l < LANES; l++)
+			start(l);
+
+		bool finished = true;
+		while (true) {
+			if (finished) {
+				int active = 0;
+				for (int l = 0; l < LANES; l++) {
+					while (pixel[l] >= 0 && (settled[l] || counts[l] >= maxIterations || !(zx[l] * zx[l] + zy[l] * zy[l] < 4))) {
+						iterations[pixel[l]] = settled[l] ? maxIterations : counts[l];
+						if (periodic)
+							periodic[pixel[l]] = settled[l];
+						start(l);
+					}
+					active += pixel[l] >= 0;
+				}
+				if (active == 0)
+					return;
+			}
+
+			int done = 0;
+			for (int l = 0; l < LANES; l++) {
+				Real x = zx[l], y = zy[l];
+				Step::step(x, y);
+				zx[l] = x + cx[l];
+				zy[l] = y + cy[l];
+				counts[l]++;
+				done |= (int)!(zx[l] * zx[l] + zy[l] * zy[l] < 4) | (int)(counts[l] >= maxIterations);
+			}
+			if (PERIODIC) {
+				// Brent's method as in FormulaKernel, whose saves land on 8, 16, 32 and so on, without branches
+				for (int l = 0; l < LANES; l++) {
+					bool same = fabs(zx[l] - savedX[l]) < tolerance && fabs(zy[l] - savedY[l]) < tolerance;
+					settled[l] = settled[l] | (same & (pixel[l] >= 0));
+					done |= (int)settled[l];
+					bool save = counts[l] == nextCheck[l];
+					savedX[l] = save ? zx[l] : savedX[l];
+					savedY[l] = save ? zy[l] : savedY[l];
+					nextCheck[l] = save ? nextCheck[l] * 2 : nextCheck[l];
+				}
+			}
+			finished = done != 0;
+		}
+	}
+};
+
+template <template <typename, typename, bool, bool> class Kernel, typename Real, bool JULIA, bool PERIODIC, typename Visitor>
+void visitStep(const Formula& formula, Visitor&& visit) {
+	Real jx = (Real)formula.juliaX, jy = (Real)formula.juliaY;
+	switch (formula.kind) {
+	case FormulaKind::BURNING_SHIP:
+		visit(Kernel<Real, BurningShipStep, JULIA, PERIODIC>{ jx, jy });
+		return;
+	case FormulaKind::TRICORN:
+		visit(Kernel<Real, TricornStep, JULIA, PERIODIC>{ jx, jy });
+		return;
+	case FormulaKind::CUSTOM:
+		visit(BytecodeKernel<Real, PERIODIC>(formula.custom->bytecode, JULIA, formula.juliaX, formula.juliaY));
+		return;
+	case FormulaKind::MULTIBROT:
+		switch (formula.power) {
+		case 3: visit(Kernel<Real, PowerStep<3>, JULIA, PERIODIC>{ jx, jy }); return;
+		case 4: visit(Kernel<Real, PowerStep<4>, JULIA, PERIODIC>{ jx, jy }); return;
+		case 5: visit(Kernel<Real, PowerStep<5>, JULIA, PERIODIC>{ jx, jy }); return;
+		case 6: visit(Kernel<Real, PowerStep<6>, JULIA, PERIODIC>{ jx, jy }); return;
+		case 7: visit(Kernel<Real, PowerStep<7>, JULIA, PERIODIC>{ jx, jy }); return;
+		case 8: visit(Kernel<Real, PowerStep<8>, JULIA, PERIODIC>{ jx, jy }); return;
+		}
+		break;
+	default:
+		break;
+	}
+	visit(Kernel<Real, SquareStep, JULIA, PERIODIC>{ jx, jy });
+}
+
+template <template <typename, typename, bool, bool> class Kernel, typename Real, bool PERIODIC, typename Visitor>
+void visitJulia(const Formula& formula, Visitor&& visit) {
+	if (formula.julia)
+		visitStep<Kernel, Real, true, PERIODIC>(formula, visit);
+	else
+		visitStep<Kernel, Real, false, PERIODIC>(formula, visit);
+}
+
+// calls visit with the kernel for the variant, a callable kernel(cx, cy, maxIterations[, periodic]) that
+// also counts whole rows with kernel.row(). rows are what the bytecode interpreter runs fastest.
+// visit is generic and instantiated once per kernel, so whatever loop it runs is specialised along with it.
+// Kernel is FormulaKernel or LaneKernel for the built in formulas, typed in ones always run as bytecode
+template <template <typename, typename, bool, bool> class Kernel = FormulaKernel, typename Visitor>
+void withKernel(const KernelVariant& variant, Visitor&& visit) {
+	if (variant.singlePrecision) {
+		if (variant.interiorCheck)
+			visitJulia<Kernel, float, true>(variant.formula, visit);
+		else
+			visitJulia<Kernel, float, false>(variant.formula, visit);
+	}
+	else {
+		if (variant.interiorCheck)
+			visitJulia<Kernel, double, true>(variant.formula, visit);
+		else
+			visitJulia<Kernel, double, false>(variant.formula, visit);
+	}
+}
+
+// renders rows [rowBegin, rowEnd) of a width x height view into a tightly packed, top-down RGB buffer
+template <typename Kernel>
+void renderRows(const Kernel& kernel, double centerX, double centerY, double scale, int width, int height, int maxIterations,
+	int rowBegin, int rowEnd, unsigned char* rgb) {
+	std::vector<double> cr(width);
+	std::vector<int> iterations(width);
+	for (int px = 0; px < width; px++)
+		cr[px] = pixelReal(centerX, scale, px, width);
+	for (int py = rowBegin; py < rowEnd; py++) {
+		unsigned char* row = rgb + (size_t)py * width * 3;
+		kernel.row(cr.data(), pixelImaginary(centerY, scale, py, height), width, maxIterations, iterations.data(), nullptr);
+		for (int px = 0; px < width; px++)
+			colorIterations(iterations[px], maxIterations, row + px * 3);
+	}
+}
+
+inline void renderView(double centerX, double centerY, double scale, int width, int height, int maxIterations, unsigned char* rgb,
+	const KernelVariant& variant = KernelVariant()) {
+	withKernel(variant, [&](const auto& kernel) {
+		renderRows(kernel, centerX, centerY, scale, width, height, maxIterations, 0, height, rgb);
+	});
+}
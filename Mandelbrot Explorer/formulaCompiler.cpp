@@ -0,0 +1,486 @@
+#include "formulaCompiler.h"
+
+#include <ctype.h>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// highest |n| accepted in z^n, past this it's a typo
+static const int MAX_EXPONENT = 64;
+
+namespace {
+	struct Node {
+		FormulaOp op;
+		int a, b;
+		double value; // of a CONSTANT
+	};
+
+	// a complex value as the two real nodes holding its parts
+	struct Value {
+		int re, im;
+	};
+
+	// the real valued graph of the formula. every node is made through here, which folds it if its operands
+	// are constants and otherwise returns the existing node for the same operation on the same operands
+	class Graph {
+	public:
+		std::vector<Node> nodes;
+
+		int constant(double value) {
+			return make({ FormulaOp::CONSTANT, -1, -1, value });
+		}
+
+		int leaf(FormulaOp op) {
+			return make({ op, -1, -1, 0.0 });
+		}
+
+		bool isConstant(int n, double value) const {
+			return nodes[n].op == FormulaOp::CONSTANT && nodes[n].value == value;
+		}
+
+		int add(int a, int b) {
+			if (isConstant(a, 0.0))
+				return b;
+			if (isConstant(b, 0.0))
+				return a;
+			return binary(FormulaOp::ADD, a, b);
+		}
+
+		int sub(int a, int b) {
+			if (isConstant(b, 0.0))
+				return a;
+			if (isConstant(a, 0.0))
+				return neg(b);
+			return binary(FormulaOp::SUB, a, b);
+		}
+
+		int mul(int a, int b) {
+			// multiplying by 0 drops the other operand even if it would have been infinite, which only
+			// matters for orbits that have long escaped
+			if (isConstant(a, 0.0) || isConstant(b, 0.0))
+				return constant(0.0);
+			if (isConstant(a, 1.0))
+				return b;
+			if (isConstant(b, 1.0))
+				return a;
+			if (isConstant(a, -1.0))
+				return neg(b);
+			if (isConstant(b, -1.0))
+				return neg(a);
+			return binary(FormulaOp::MUL, a, b);
+		}
+
+		int div(int a, int b) {
+			if (isConstant(b, 1.0))
+				return a;
+			return binary(FormulaOp::DIV, a, b);
+		}
+
+		int neg(int a) {
+			if (nodes[a].op == FormulaOp::NEG)
+				return nodes[a].a;
+			return unary(FormulaOp::NEG, a);
+		}
+
+		int abs(int a) {
+			if (nodes[a].op == FormulaOp::ABS)
+				return a;
+			return unary(FormulaOp::ABS, a);
+		}
+
+	private:
+		std::map<std::tuple<int, int, int, double>, int> existing;
+
+		int make(const Node& node) {
+			auto key = std::make_tuple((int)node.op, node.a, node.b, node.value);
+			auto found = existing.find(key);
+			if (found != existing.end())
+				return found->second;
+			nodes.push_back(node);
+			existing[key] = (int)nodes.size() - 1;
+			return (int)nodes.size() - 1;
+		}
+
+		int binary(FormulaOp op, int a, int b) {
+			const Node& x = nodes[a];
+			const Node& y = nodes[b];
+			if (x.op == FormulaOp::CONSTANT && y.op == FormulaOp::CONSTANT) {
+				switch (op) {
+				case FormulaOp::ADD: return constant(x.value + y.value);
+				case FormulaOp::SUB: return constant(x.value - y.value);
+				case FormulaOp::MUL: return constant(x.value * y.value);
+				default: return constant(x.value / y.value);
+				}
+			}
+			// operands in a fixed order, so a*b and b*a are the same node
+			if ((op == FormulaOp::ADD || op == FormulaOp::MUL) && a > b)
+				std::swap(a, b);
+			return make({ op, a, b, 0.0 });
+		}
+
+		int unary(FormulaOp op, int a) {
+			const Node& x = nodes[a];
+			if (x.op == FormulaOp::CONSTANT)
+				return constant(op == FormulaOp::NEG ? -x.value : fabs(x.value));
+			return make({ op, a, -1, 0.0 });
+		}
+	};
+
+	class Parser {
+	public:
+		Parser(const std::string& text, Graph& graph) : text(text), graph(graph) {
+			z = { graph.leaf(FormulaOp::Z_RE), graph.leaf(FormulaOp::Z_IM) };
+			c = { graph.leaf(FormulaOp::C_RE), graph.leaf(FormulaOp::C_IM) };
+		}
+
+		bool parse(Value& out, std::string& message) {
+			bool parsed = expression(out) && (skipSpace(), position == text.size() || fail("unexpected '" + text.substr(position, 1) + "'"));
+			if (!parsed)
+				message = error + " at column " + std::to_string(errorPosition + 1);
+			return parsed;
+		}
+
+	private:
+		const std::string& text;
+		Graph& graph;
+		Value z, c;
+		size_t position = 0;
+		std::string error;
+		size_t errorPosition = 0;
+
+		bool fail(const std::string& message) {
+			error = message;
+			errorPosition = position;
+			return false;
+		}
+
+		void skipSpace() {
+			while (position < text.size() && isspace((unsigned char)text[position]))
+				position++;
+		}
+
+		bool accept(char symbol) {
+			skipSpace();
+			if (position < text.size() && text[position] == symbol) {
+				position++;
+				return true;
+			}
+			return false;
+		}
+
+		Value real(int n) {
+			return { n, graph.constant(0.0) };
+		}
+
+		Value add(Value a, Value b) { return { graph.add(a.re, b.re), graph.add(a.im, b.im) }; }
+		Value sub(Value a, Value b) { return { graph.sub(a.re, b.re), graph.sub(a.im, b.im) }; }
+		Value neg(Value a) { return { graph.neg(a.re), graph.neg(a.im) }; }
+
+		Value mul(Value a, Value b) {
+			return { graph.sub(graph.mul(a.re, b.re), graph.mul(a.im, b.im)), graph.add(graph.mul(a.re, b.im), graph.mul(a.im, b.re)) };
+		}
+
+		Value div(Value a, Value b) {
+			int d = graph.add(graph.mul(b.re, b.re), graph.mul(b.im, b.im));
+			return { graph.div(graph.add(graph.mul(a.re, b.re), graph.mul(a.im, b.im)), d),
+				graph.div(graph.sub(graph.mul(a.im, b.re), graph.mul(a.re, b.im)), d) };
+		}
+
+		// by squaring, so z^8 is three multiplies
+		Value power(Value base, int exponent) {
+			if (exponent < 0)
+				return div(real(graph.constant(1.0)), power(base, -exponent));
+			Value result = real(graph.constant(1.0));
+			while (exponent > 0) {
+				if (exponent & 1)
+					result = mul(result, base);
+				exponent >>= 1;
+				if (exponent > 0)
+					base = mul(base, base);
+			}
+			return result;
+		}
+
+		bool expression(Value& out) {
+			if (!term(out))
+				return false;
+			while (true) {
+				Value right;
+				if (accept('+')) {
+					if (!term(right))
+						return false;
+					out = add(out, right);
+				}
+				else if (accept('-')) {
+					if (!term(right))
+						return false;
+					out = sub(out, right);
+				}
+				else {
+					return true;
+				}
+			}
+		}
+
+		bool term(Value& out) {
+			if (!unary(out))
+				return false;
+			while (true) {
+				Value right;
+				if (accept('*')) {
+					if (!unary(right))
+						return false;
+					out = mul(out, right);
+				}
+				else if (accept('/')) {
+					if (!unary(right))
+						return false;
+					out = div(out, right);
+				}
+				else {
+					return true;
+				}
+			}
+		}
+
+		bool unary(Value& out) {
+			if (accept('-')) {
+				if (!unary(out))
+					return false;
+				out = neg(out);
+				return true;
+			}
+			if (!primary(out))
+				return false;
+			if (accept('^')) {
+				skipSpace();
+				bool negative = accept('-');
+				skipSpace();
+				if (position >= text.size() || !isdigit((unsigned char)text[position]))
+					return fail("expected an integer power");
+				char* end;
+				long exponent = strtol(text.c_str() + position, &end, 10);
+				if (*end == '.' || *end == 'e' || *end == 'E')
+					return fail("expected an integer power");
+				if (exponent > MAX_EXPONENT)
+					return fail("power above " + std::to_string(MAX_EXPONENT));
+				position = end - text.c_str();
+				out = power(out, negative ? -(int)exponent : (int)exponent);
+			}
+			return true;
+		}
+
+		bool primary(Value& out) {
+			skipSpace();
+			if (position >= text.size())
+				return fail("unexpected end of formula");
+			char first = text[position];
+			if (isdigit((unsigned char)first) || first == '.') {
+				char* end;
+				double value = strtod(text.c_str() + position, &end);
+				if (end == text.c_str() + position)
+					return fail("expected a number");
+				position = end - text.c_str();
+				if (position < text.size() && text[position] == 'i' && (position + 1 == text.size() || !isalnum((unsigned char)text[position + 1]))) {
+					position++;
+					out = { graph.constant(0.0), graph.constant(value) };
+				}
+				else {
+					out = real(graph.constant(value));
+				}
+				return true;
+			}
+			if (accept('(')) {
+				if (!expression(out))
+					return false;
+				return accept(')') || fail("expected ')'");
+			}
+			if (!isalpha((unsigned char)first))
+				return fail("unexpected '" + std::string(1, first) + "'");
+
+			size_t nameStart = position;
+			while (position < text.size() && isalnum((unsigned char)text[position]))
+				position++;
+			std::string name = text.substr(nameStart, position - nameStart);
+			if (name == "z") {
+				out = z;
+				return true;
+			}
+			if (name == "c") {
+				out = c;
+				return true;
+			}
+			if (name == "i") {
+				out = { graph.constant(0.0), graph.constant(1.0) };
+				return true;
+			}
+
+			static const char* functions[] = { "conj", "abs", "re", "im", "sqr", "norm" };
+			bool known = false;
+			for (const char* function : functions)
+				known = known || name == function;
+			if (!known) {
+				position = nameStart;
+				return fail("unknown name '" + name + "'");
+			}
+			Value argument;
+			if (!accept('('))
+				return fail("expected '(' after " + name);
+			if (!expression(argument))
+				return false;
+			if (!accept(')'))
+				return fail("expected ')'");
+			if (name == "conj")
+				out = { argument.re, graph.neg(argument.im) };
+			else if (name == "abs")
+				out = { graph.abs(argument.re), graph.abs(argument.im) };
+			else if (name == "re")
+				out = real(argument.re);
+			else if (name == "im")
+				out = real(argument.im);
+			else if (name == "sqr")
+				out = mul(argument, argument);
+			else
+				out = real(graph.add(graph.mul(argument.re, argument.re), graph.mul(argument.im, argument.im)));
+			return true;
+		}
+	};
+
+	// a GLSL constant that keeps every bit of the double, converted to REAL where it's used
+	std::string literal(double value) {
+		char text[64];
+		snprintf(text, sizeof(text), "REAL(%.17elf)", value);
+		return text;
+	}
+
+	// one statement per node, the GLSL compiler allocates its own registers
+	std::string emitGlsl(const Graph& graph, const std::vector<bool>& used, Value result) {
+		std::vector<std::string> names(graph.nodes.size());
+		std::string body;
+		for (size_t n = 0; n < graph.nodes.size(); n++) {
+			if (!used[n])
+				continue;
+			const Node& node = graph.nodes[n];
+			switch (node.op) {
+			case FormulaOp::CONSTANT: names[n] = literal(node.value); continue;
+			case FormulaOp::Z_RE: names[n] = "z.x"; continue;
+			case FormulaOp::Z_IM: names[n] = "z.y"; continue;
+			case FormulaOp::C_RE: names[n] = "c.x"; continue;
+			case FormulaOp::C_IM: names[n] = "c.y"; continue;
+			default: break;
+			}
+			names[n] = "t" + std::to_string(n);
+			std::string a = names[node.a], b = node.b >= 0 ? names[node.b] : "";
+			std::string value;
+			switch (node.op) {
+			case FormulaOp::ADD: value = a + " + " + b; break;
+			case FormulaOp::SUB: value = a + " - " + b; break;
+			case FormulaOp::MUL: value = a + " * " + b; break;
+			case FormulaOp::DIV: value = a + " / " + b; break;
+			case FormulaOp::NEG: value = "-" + a; break;
+			default: value = "abs(" + a + ")"; break;
+			}
+			body += "\tREAL " + names[n] + " = " + value + ";\n";
+		}
+		return "VEC formulaStep(VEC z, VEC c) {\n" + body + "\treturn VEC(" + names[result.re] + ", " + names[result.im] + ");\n}\n";
+	}
+
+	// registers in node order, each freed after its last use so a long formula keeps a small register file
+	bool emitBytecode(const Graph& graph, const std::vector<bool>& used, Value result, Bytecode& out, std::string& error) {
+		size_t count = graph.nodes.size();
+		std::vector<size_t> lastUse(count, 0);
+		for (size_t n = 0; n < count; n++) {
+			if (!used[n])
+				continue;
+			const Node& node = graph.nodes[n];
+			if (node.a >= 0)
+				lastUse[node.a] = n;
+			if (node.b >= 0)
+				lastUse[node.b] = n;
+		}
+		lastUse[result.re] = lastUse[result.im] = count;
+
+		std::vector<int> registers(count, -1);
+		std::vector<int> free;
+		int next = 4;
+		for (size_t n = 0; n < count; n++) {
+			if (!used[n])
+				continue;
+			const Node& node = graph.nodes[n];
+			switch (node.op) {
+			case FormulaOp::Z_RE: registers[n] = Z_RE_REGISTER; continue;
+			case FormulaOp::Z_IM: registers[n] = Z_IM_REGISTER; continue;
+			case FormulaOp::C_RE: registers[n] = C_RE_REGISTER; continue;
+			case FormulaOp::C_IM: registers[n] = C_IM_REGISTER; continue;
+			case FormulaOp::CONSTANT:
+				// constants are loaded once per batch and keep their register
+				out.constants.push_back(node.value);
+				registers[n] = next++;
+				if (next > MAX_REGISTERS) {
+					error = "formula has more than " + std::to_string(MAX_REGISTERS - 4) + " constants";
+					return false;
+				}
+				continue;
+			default: break;
+			}
+		}
+		for (size_t n = 0; n < count; n++) {
+			if (!used[n] || registers[n] >= 0)
+				continue;
+			const Node& node = graph.nodes[n];
+			if (free.empty()) {
+				free.push_back(next++);
+			}
+			registers[n] = free.back();
+			free.pop_back();
+			if (next > MAX_REGISTERS) {
+				error = "formula too long, it needs more than " + std::to_string(MAX_REGISTERS) + " registers";
+				return false;
+			}
+			out.code.push_back({ node.op, (uint8_t)registers[n], (uint8_t)registers[node.a], (uint8_t)(node.b >= 0 ? registers[node.b] : 0) });
+			// operands that die here give their registers back, unless they are inputs or constants
+			for (int operand : { node.a, node.b }) {
+				if (operand >= 0 && lastUse[operand] == n && registers[operand] >= 4 + (int)out.constants.size()
+					&& (operand != node.b || node.a != node.b))
+					free.push_back(registers[operand]);
+			}
+		}
+		out.registers = next;
+		out.outRe = registers[result.re];
+		out.outIm = registers[result.im];
+		return true;
+	}
+}
+
+bool compileFormula(const std::string& text, CompiledFormula& out, std::string& error) {
+	Graph graph;
+	Parser parser(text, graph);
+	Value result;
+	if (!parser.parse(result, error))
+		return false;
+
+	// only what z' depends on, which drops whatever folding left behind
+	std::vector<bool> used(graph.nodes.size(), false);
+	used[result.re] = used[result.im] = true;
+	for (size_t n = graph.nodes.size(); n-- > 0;) {
+		if (!used[n])
+			continue;
+		if (graph.nodes[n].a >= 0)
+			used[graph.nodes[n].a] = true;
+		if (graph.nodes[n].b >= 0)
+			used[graph.nodes[n].b] = true;
+	}
+
+	CompiledFormula compiled;
+	compiled.text = text;
+	if (!emitBytecode(graph, used, result, compiled.bytecode, error))
+		return false;
+	compiled.glsl = emitGlsl(graph, used, result);
+	out = compiled;
+	return true;
+}
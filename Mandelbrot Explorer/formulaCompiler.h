@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "bytecode.h"
+
+// user formulas for z', written as a complex expression in z and c, such as "z^3 - 0.5*z + c" or
+// "abs(z)^2 + c". the language has
+//   z, c, i and real numbers, which may carry an i to make them imaginary (0.5i)
+//   + - * / and ^ to an integer power, with the usual precedence
+//   conj(x), abs(x) of each part as the Burning Ship takes it, re(x), im(x), sqr(x) and norm(x) = |x|^2
+// the expression is taken apart into real arithmetic on the parts of z and c. constants are folded, and
+// equal subexpressions are built once, so z*z and z^2 cost the same. the result runs on the CPU as
+// bytecode and on the GPU as GLSL generated from the same operations
+struct CompiledFormula {
+	std::string text;
+	Bytecode bytecode;
+	// the function VEC formulaStep(VEC z, VEC c) for iterateShader.glsl, in terms of its REAL and VEC
+	std::string glsl;
+};
+
+// false with a message saying what is wrong and where, if the text is not a formula
+bool compileFormula(const std::string& text, CompiledFormula& out, std::string& error);
@@ -3,33 +3,33 @@
 out vec4 fragColor;
 in vec4 vertexColor;
 
-uniform dvec2 resolution;
-
-uniform dvec2 centerPosition;
-uniform double scale;
+// iteration counts written by iterateShader.glsl
+uniform usampler2D iterationTexture;
+// distance estimates in pixels, read when boundaryShading is set
+uniform sampler2D distanceTexture;
+uniform int boundaryShading;
 
 uniform int maxIterations;
+// the cap of a render still being taken a pass a frame, where the orbits that haven't escaped stopped
+uniform int reachedIterations;
 
 float norm(float _x) {
 	//return _x * 2.0 - 1.0;
 	return _x;
 }
 
-uniform double test;
-
 void main() {
-	dvec2 coord = gl_FragCoord.xy/resolution * 2.0 - dvec2(1.0, 1.0);
-	 
-	dvec2 c = coord * scale + centerPosition; // transform the coord
-	dvec2 z = c;
+	// the stored count can be past the limit if maxIterations was lowered since it was computed
+	uint iterations = min(texelFetch(iterationTexture, ivec2(gl_FragCoord.xy), 0).r, uint(maxIterations));
+	// those may still escape, until then they look like the inside of the set
+	if (iterations >= uint(reachedIterations))
+		iterations = uint(maxIterations);
 
-	float iterations = 1.0;
-	while (iterations < maxIterations && z.x * z.x + z.y * z.y < 4.0) {
-		z = dvec2(z.x * z.x - z.y * z.y + c.x, 2.0 * z.x * z.y + c.y);
-		iterations++;
-	}
-
-	float n = iterations * 50 / maxIterations;
+	float n = float(iterations) * 50 / maxIterations;
 
 	fragColor = vec4(norm(sin(n)), norm(sin(n + 2.45)), norm(sin(n + 5.45)), 1.0);
-};
\ No newline at end of file
+
+	// darken escaped pixels within a pixel or so of the boundary, which traces filaments too thin to show
+	if (boundaryShading != 0 && iterations < uint(maxIterations))
+		fragColor.rgb *= clamp(texelFetch(distanceTexture, ivec2(gl_FragCoord.xy), 0).r, 0.0, 1.0);
+};
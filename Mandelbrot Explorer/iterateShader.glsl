@@ -0,0 +1,156 @@
+#version 400 core
+
+// advances every pixel's orbit up to maxIterations, either from z = c or from the state left by the
+// previous pass. z is stored bit exact in four uints.
+// the formula and precision come from what shaderDefines() in formula.cpp inserts above this: the REAL and
+// VEC types with PACK and UNPACK for the stored state, formulaStep(z, c) for z', JULIA and
+// JULIA_C for a Julia set, and INTERIOR_CHECK to stop orbits that settle into a cycle.
+// the Mandelbrot set in doubles also has a DISTANCE_ESTIMATE variant, which also carries dz/dc and writes Milnor's
+// distance estimate in pixels (0 for pixels that haven't escaped). the plain variant doesn't pay for it.
+// with COMPUTE it is a compute shader instead, which updates the state in place through images rather than
+// reading one set of textures and drawing into the other
+#ifdef COMPUTE
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (rgba32ui) uniform uimage2D orbitImage;
+layout (r32ui) uniform uimage2D iterationImage;
+#ifdef DISTANCE_ESTIMATE
+layout (rgba32ui) uniform uimage2D derivativeImage;
+layout (r32f) uniform image2D distanceImage;
+#endif
+#else
+layout (location=0) out uvec4 orbit;
+layout (location=1) out uint iterationCount;
+#ifdef DISTANCE_ESTIMATE
+layout (location=2) out uvec4 derivative;
+layout (location=3) out float distance;
+#endif
+
+uniform usampler2D previousOrbit;
+uniform usampler2D previousIterations;
+#ifdef DISTANCE_ESTIMATE
+uniform usampler2D previousDerivative;
+#endif
+#endif
+uniform int restart;
+
+uniform dvec2 resolution;
+
+uniform dvec2 centerPosition;
+uniform double scale;
+
+uniform int maxIterations;
+
+#ifdef INTERIOR_CHECK
+// iteration count of a pixel proven to be inside the set, past any cap so later passes leave it alone
+const uint INTERIOR = 0xFFFFFFFFu;
+#endif
+
+#ifdef DISTANCE_ESTIMATE
+// steps past the escape radius that sharpen the estimate, as DISTANCE_STEPS in kernel.h
+const int DISTANCE_STEPS = 4;
+
+dvec2 multiply(dvec2 a, dvec2 b) {
+	return dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+#endif
+
+void main() {
+#ifdef COMPUTE
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	// the last groups hang over the edges
+	if (pixel.x >= int(resolution.x) || pixel.y >= int(resolution.y))
+		return;
+	dvec2 coord = (dvec2(pixel) + 0.5)/resolution * 2.0 - dvec2(1.0, 1.0);
+#else
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	dvec2 coord = gl_FragCoord.xy/resolution * 2.0 - dvec2(1.0, 1.0);
+#endif
+
+	VEC start = VEC(coord * scale + centerPosition); // transform the coord
+#ifdef JULIA
+	VEC c = JULIA_C;
+#else
+	VEC c = start;
+#endif
+	VEC z = start;
+	uint iterations = 1u;
+#ifdef DISTANCE_ESTIMATE
+	dvec2 dz = dvec2(1.0, 0.0);
+#endif
+
+	if (restart == 0) {
+#ifdef COMPUTE
+		uvec4 previous = imageLoad(orbitImage, pixel);
+		iterations = imageLoad(iterationImage, pixel).r;
+#else
+		uvec4 previous = texelFetch(previousOrbit, pixel, 0);
+		iterations = texelFetch(previousIterations, pixel, 0).r;
+#endif
+		z = UNPACK(previous);
+#ifdef DISTANCE_ESTIMATE
+#ifdef COMPUTE
+		previous = imageLoad(derivativeImage, pixel);
+#else
+		previous = texelFetch(previousDerivative, pixel, 0);
+#endif
+		dz = dvec2(packDouble2x32(previous.xy), packDouble2x32(previous.zw));
+#endif
+	}
+
+	// a negative limit would wrap to billions of iterations as a uint
+	uint limit = uint(max(maxIterations, 1));
+#ifdef INTERIOR_CHECK
+	// Brent's method as in formula.h, starting over from wherever the previous pass left the orbit
+	VEC saved = z;
+	uint checkInterval = 8u;
+#endif
+	while (iterations < limit && z.x * z.x + z.y * z.y < 4.0) {
+#ifdef DISTANCE_ESTIMATE
+		dz = 2.0 * multiply(z, dz) + dvec2(1.0, 0.0);
+#endif
+		z = formulaStep(z, c);
+		iterations++;
+#ifdef INTERIOR_CHECK
+		if (all(lessThan(abs(z - saved), VEC(TOLERANCE)))) {
+			iterations = INTERIOR;
+			break;
+		}
+		if (iterations % checkInterval == 0u) {
+			saved = z;
+			checkInterval *= 2u;
+		}
+#endif
+	}
+
+#ifdef DISTANCE_ESTIMATE
+	float estimate = 0.0;
+	if (iterations < limit) {
+		// on copies, so a later pass that resumes from the stored state gets the same estimate
+		dvec2 ez = z, edz = dz;
+		for (int i = 0; i < DISTANCE_STEPS; i++) {
+			edz = 2.0 * multiply(ez, edz);
+			ez = multiply(ez, ez) + c;
+		}
+		// no double log in GLSL, but ln|z| needs nothing like a double's precision
+		double magnitude = length(ez);
+		double pixelSize = 2.0 * scale / resolution.y;
+		estimate = float(2.0 * magnitude * double(log(float(magnitude))) / length(edz) / pixelSize);
+	}
+#endif
+
+#ifdef COMPUTE
+	imageStore(orbitImage, pixel, PACK(z));
+	imageStore(iterationImage, pixel, uvec4(iterations));
+#ifdef DISTANCE_ESTIMATE
+	imageStore(derivativeImage, pixel, uvec4(unpackDouble2x32(dz.x), unpackDouble2x32(dz.y)));
+	imageStore(distanceImage, pixel, vec4(estimate));
+#endif
+#else
+	orbit = PACK(z);
+	iterationCount = iterations;
+#ifdef DISTANCE_ESTIMATE
+	derivative = uvec4(unpackDouble2x32(dz.x), unpackDouble2x32(dz.y));
+	distance = estimate;
+#endif
+#endif
+}
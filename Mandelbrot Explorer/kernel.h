@@ -0,0 +1,96 @@
+#pragma once
+
+#include <math.h>
+
+#include "floatExp.h"
+
+// CPU port of fragmentShader.glsl, used wherever a frame has to be produced away from the GL context.
+// Keep these in step with the shader so that tiles and exports match what the window shows.
+
+// steps taken past the escape radius for a distance estimate. the estimate assumes |z| is large, and
+// these sharpen it without touching the iteration count
+static const int DISTANCE_STEPS = 4;
+
+// Milnor's exterior distance estimate 2 |z| ln|z| / |dz/dc| for an escaped z, in the units dz/dc was
+// measured in. the kernels carry dz/dc times the pixel spacing where it could outgrow a double, which makes
+// this the distance in pixels; deep renders carry that as FloatExp. c only needs to be roughly right once z
+// has escaped
+template <typename Real>
+inline double escapeDistance(double zx, double zy, Real dx, Real dy, double cx, double cy) {
+	for (int i = 0; i < DISTANCE_STEPS; i++) {
+		// the + 1 of dz' = 2 z dz + 1 is lost next to 2 z dz out here
+		Real t = 2.0 * (zx * dx - zy * dy);
+		dy = 2.0 * (zx * dy + zy * dx);
+		dx = t;
+		double tx = zx * zx - zy * zy + cx;
+		zy = 2.0 * zx * zy + cy;
+		zx = tx;
+	}
+	// hypot, since the squares of a derivative in pixels can underflow
+	double z = sqrt(zx * zx + zy * zy);
+	Real dz = hypot(dx, dy);
+	if (!(dz > 0.0))
+		return 0.0;
+	return toDouble(2.0 * z * log(z) / dz);
+}
+
+// the iteration, with dz/dc carried along when DISTANCE is set to fill in distance: the estimate in
+// pixels of pixelSize for pixels that escaped, 0 for those that didn't. without it the derivative compiles
+// away, so runs that don't need it pay nothing
+template <bool DISTANCE>
+inline int iterateKernel(double cx, double cy, int maxIterations, double pixelSize, float& distance) {
+	double zx = cx, zy = cy;
+	double dx = 1.0, dy = 0.0; // dz/dc at z = c
+	int iterations = 1;
+	while (iterations < maxIterations && zx * zx + zy * zy < 4.0) {
+		if (DISTANCE) {
+			double t = 2.0 * (zx * dx - zy * dy) + 1.0;
+			dy = 2.0 * (zx * dy + zy * dx);
+			dx = t;
+		}
+		double tx = zx * zx - zy * zy + cx;
+		zy = 2.0 * zx * zy + cy;
+		zx = tx;
+		iterations++;
+	}
+	if (DISTANCE)
+		distance = iterations < maxIterations ? (float)(escapeDistance(zx, zy, dx, dy, cx, cy) / pixelSize) : 0.0f;
+	return iterations;
+}
+
+// number of iterations before z escapes, counted the same way the shader does (starting at z = c, count = 1)
+inline int mandelbrotIterations(double cx, double cy, int maxIterations) {
+	float unused;
+	return iterateKernel<false>(cx, cy, maxIterations, 0.0, unused);
+}
+
+// the same count, and the distance estimate in pixels of the given size
+inline int mandelbrotDistance(double cx, double cy, int maxIterations, double pixelSize, float& distance) {
+	return iterateKernel<true>(cx, cy, maxIterations, pixelSize, distance);
+}
+
+// the shader writes sin() straight to an 8 bit framebuffer, so negative values clamp to black
+inline unsigned char colorChannel(float v) {
+	if (v <= 0.0f)
+		return 0;
+	if (v >= 1.0f)
+		return 255;
+	return (unsigned char)(v * 255.0f + 0.5f);
+}
+
+inline void colorIterations(int iterations, int maxIterations, unsigned char* rgb) {
+	float n = (float)iterations * 50 / maxIterations;
+	rgb[0] = colorChannel(sinf(n));
+	rgb[1] = colorChannel(sinf(n + 2.45f));
+	rgb[2] = colorChannel(sinf(n + 5.45f));
+}
+
+// fractal space coordinate of a pixel center, using the shader's mapping: both axes span [-scale, scale]
+// around the center regardless of aspect ratio. row 0 is the top of the image.
+inline double pixelReal(double centerX, double scale, int px, int width) {
+	return ((px + 0.5) / width * 2.0 - 1.0) * scale + centerX;
+}
+
+inline double pixelImaginary(double centerY, double scale, int py, int height) {
+	return ((height - py - 0.5) / height * 2.0 - 1.0) * scale + centerY;
+}
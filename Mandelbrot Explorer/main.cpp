@@ -16,14 +16,43 @@
 #include <vector>
 #include <locale>
 #include <codecvt>
+#include <future>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <memory>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
 #include "stb_image_write.h"
 
-double x = 0.0, y = 0.0;
-double scale = 1.0;
+#include "autoIterations.h"
+#include "bigFixed.h"
+#include "buddhabrot.h"
+#include "dziExport.h"
+#include "fixed128.h"
+#include "formula.h"
+#include "kernel.h"
+#include "numa.h"
+#include "orbitCache.h"
+#include "orbitStream.h"
+#include "perturbation.h"
+#include "programCache.h"
+#include "renderer.h"
+#include "shaderSources.h"
+#include "supersample.h"
+#include "threadPool.h"
+#include "tileSchedule.h"
+#include "tileServer.h"
+#include "zoomTarget.h"
+
+// the view is kept in full precision so that panning and zooming work at any depth and a saved view
+// renders the same frame again. x and y carry BigFixed::limbsForScale(scale) fraction limbs; the kernels
+// get doubles or offsets from the center, whatever they can use
+BigFixed x, y;
+FloatExp scale = 1.0;
 bool mouseDown = false;
 double lastX, lastY;
 bool mouseCalled = false;
@@ -32,13 +61,125 @@ double mx = 0.0, my = 0.0;
 int maxIterations = 64;
 
 bool zooming = false;
-double zoomLocation[] = { 0, 0 };
+BigFixed zoomLocation[2];
+// a rendered zoom into a minibrot stops once it fills the view. 0 zooms until escape is pressed
+FloatExp zoomEnd = 0.0;
+std::wstring zoomTargetText;
 
 unsigned int zoomIndex = 0;
+std::ofstream frameLog;
+
+bool antialias = false;
+bool antialiasKeyDown = false;
+
+// darkens the pixels next to the boundary using distance estimates, from the kernels' variants that carry
+// dz/dc. off by default, since carrying it costs every iteration
+bool boundaryShading = false;
+bool boundaryKeyDown = false;
+SupersampleStats antialiasStats = { 0, 1 };
+
+// the fractal being explored and how its kernels are specialised, from the command line.
+// the interior check follows autoIterations, whose probes already pay for it
+KernelVariant kernelVariant;
+
+// which engine computes the live view's counts, switched with B. past the shader's precision the deep
+// renderer takes over whichever it is
+Backend backend = Backend::GPU_FRAGMENT;
+bool backendKeyDown = false;
+
+bool autoIterations = false;
+bool autoKeyDown = false;
+int autoIterationCeiling = 1 << 20;
+std::future<int> iterationProbe;
+// what the running or last probe looked at, so that a view that hasn't changed isn't probed again.
+// probedIterations is 0 when there is none
+BigFixed probedX, probedY;
+FloatExp probedScale = 0.0;
+int probedIterations = 0, probedCeiling = 0;
+
+// the live view past the shader's precision: rendered on the CPU with perturbation against an orbit that
+// a background thread computes, and shown from deepTexture once a frame of the current view is ready
+struct DeepFrame {
+	BigFixed x, y;
+	FloatExp scale;
+	int width, height, maxIterations;
+	int orbitLength; // orbit values published when it was rendered, it is redone as more arrive
+	std::vector<int> iterations;
+	std::vector<float> distances; // only while boundary shading is on
+};
+std::future<DeepFrame> deepFrameJob;
+DeepFrame deepFrame = { BigFixed(), BigFixed(), 0.0, 0, 0, 0, 0, {}, {} };
+unsigned int deepTexture = 0;
+unsigned int deepDistanceTexture = 0;
+
+// worker threads for anything rendered on the CPU from the interactive explorer, pinned over every NUMA node
+ThreadPool& cpuPool() {
+	static ThreadPool pool(0, numaNodeCount());
+	return pool;
+}
+
+// reference orbits of deep renders, kept between runs
+OrbitCache& orbitCache() {
+	static OrbitCache cache("orbits");
+	return cache;
+}
+
+// computes the live view's reference orbit in the background
+OrbitStream& orbitStream() {
+	static OrbitStream stream;
+	return stream;
+}
+
+// keeps x and y at the precision the current scale needs, extending them as the view zooms in
+void fitPrecision() {
+	int limbs = BigFixed::limbsForScale(scale);
+	if (x.fractionLimbs() != limbs || y.fractionLimbs() != limbs) {
+		x = x.withPrecision(limbs);
+		y = y.withPrecision(limbs);
+	}
+}
+
+// offset of the cursor from the view center in fractal space
+FloatExp cursorOffsetX() {
+	return (mx / width * 2 - 1) * scale;
+}
+
+FloatExp cursorOffsetY() {
+	return ((height - my) / height * 2 - 1) * scale;
+}
+
+// renders a view on the CPU with perturbation and writes it as a png
+int saveDeepImage(const char* filepath, const DeepView& view, int iterationCount) {
+	std::vector<int> iterations((size_t)view.width * view.height);
+	PerturbationOptions options;
+	options.cache = &orbitCache();
+	PerturbationStats stats = renderPerturbation(view, iterationCount, cpuPool(), iterations.data(), options);
+	std::vector<unsigned char> image(iterations.size() * 3);
+	for (size_t i = 0; i < iterations.size(); i++)
+		colorIterations(iterations[i], iterationCount, &image[i * 3]);
+	stbi_flip_vertically_on_write(false);
+	if (!stbi_write_png(filepath, view.width, view.height, 3, image.data(), view.width * 3))
+		return -1;
+	return stats.glitchedPixels > 0 ? 1 : 0;
+}
 
 void saveImage(const char* filepath, GLFWwindow* w) {
 	int width, height;
 	glfwGetFramebufferSize(w, &width, &height);
+	if (scale < PERTURBATION_SCALE && kernelVariant.formula.isMandelbrot()) {
+		// the shader's doubles can't resolve this, so render against high precision reference orbits
+		DeepView view = { x, y, scale, scale, width, height };
+		saveDeepImage(filepath, view, maxIterations);
+		return;
+	}
+	if (antialias) {
+		// re-render the frame on the CPU, adding sub-samples only where neighbouring pixels disagree
+		std::vector<unsigned char> image((size_t)width * height * 3);
+		antialiasStats = renderAdaptive(x.toDouble(), y.toDouble(), scale.toDouble(), width, height, maxIterations, cpuPool(), image.data(), kernelVariant);
+		stbi_flip_vertically_on_write(false);
+		stbi_write_png(filepath, width, height, 3, image.data(), width * 3);
+		return;
+	}
 	GLsizei nrChannels = 3;
 	GLsizei stride = nrChannels * width;
 	stride += (stride % 4) ? (4 - stride % 4) : 0;
@@ -66,21 +207,22 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
 			lastY = ypos;
 
 			if (mouseDown) {
-				x -= dx / width * scale * 2;
-				y += dy / height * scale * 2;
+				x = x - BigFixed::fromFloatExp(dx / width * 2 * scale, x.fractionLimbs());
+				y = y + BigFixed::fromFloatExp(dy / height * 2 * scale, y.fractionLimbs());
 			}
 		}
 	}
 }
 
-// zooms in the fractal view centered on a specific x, y position in fractal space
-// more accurately, centered on a particular complex number (real component is x, imaginary is y)
-void zoom(double xlocation, double ylocation, double scaleFactor) {
+// zooms in the fractal view centered on a specific position in fractal space, given as its offset from
+// the view center. the point stays where it is on screen, so the center moves towards it by 1 - scaleFactor
+// of the offset. only the offset is scaled, which keeps this cheap however many limbs x and y have
+void zoom(const FloatExp& xOffset, const FloatExp& yOffset, double scaleFactor) {
 	if (scaleFactor > 0) {
-		double prevScale = scale;
-		scale *= scaleFactor;
-		x = scale + xlocation - scale / prevScale * (xlocation - x + prevScale);
-		y = scale + ylocation - scale / prevScale * (ylocation - y + prevScale);
+		scale = scale * scaleFactor;
+		fitPrecision();
+		x = x + BigFixed::fromFloatExp(xOffset * (1 - scaleFactor), x.fractionLimbs());
+		y = y + BigFixed::fromFloatExp(yOffset * (1 - scaleFactor), y.fractionLimbs());
 	}
 }
 
@@ -93,7 +235,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
 
 		double off = 1 + yoffset;
 		if (off > 0) {
-			zoom(mx / width * scale * 2 + (x - scale), (height - my) / height * scale * 2 + (y - scale), off);
+			zoom(cursorOffsetX(), cursorOffsetY(), off);
 		}
 	}
 }
@@ -105,23 +247,408 @@ void clear_console(HANDLE console) {
 			WriteConsoleOutputCharacter(console, L" ", 1, { i, j }, &written);
 }
 
+// runs a statistics probe of the current view in the background whenever the view, maxIterations or the
+// ceiling changes, and applies its choice of maxIterations when it finishes, so the loop never waits on it
+void updateAutoIterations() {
+	if (iterationProbe.valid()) {
+		if (iterationProbe.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+		maxIterations = iterationProbe.get();
+	}
+	if (probedIterations == maxIterations && probedCeiling == autoIterationCeiling && !(probedScale < scale) && !(scale < probedScale)
+		&& probedX.fractionLimbs() == x.fractionLimbs() && probedY.fractionLimbs() == y.fractionLimbs()
+		&& (probedX - x).isZero() && (probedY - y).isZero())
+		return;
+	probedX = x;
+	probedY = y;
+	probedScale = scale;
+	probedIterations = maxIterations;
+	probedCeiling = autoIterationCeiling;
+
+	int probeIterations = maxIterations, ceiling = autoIterationCeiling;
+	if (scale < PERTURBATION_SCALE && kernelVariant.formula.isMandelbrot()) {
+		// past double precision, as the deep view and the rendered zoom's frames are drawn
+		DeepView view = { x, y, scale, scale, width, height };
+		iterationProbe = cpuPool().submit([=]() {
+			return probeMaxIterations(view, probeIterations, ceiling, cpuPool(), &orbitCache());
+		});
+		return;
+	}
+	double probeX = x.toDouble(), probeY = y.toDouble(), probeScale = scale.toDouble();
+	KernelVariant variant = kernelVariant;
+	iterationProbe = cpuPool().submit([=]() {
+		return probeMaxIterations(probeX, probeY, probeScale, probeIterations, ceiling, cpuPool(), variant);
+	});
+}
+
+// whether the last deep frame is of the view on screen now, whatever its iteration count
+bool deepFrameCurrent() {
+	return deepFrame.width == width && deepFrame.height == height && !(deepFrame.scale < scale) && !(scale < deepFrame.scale)
+		&& deepFrame.x.fractionLimbs() == x.fractionLimbs() && (deepFrame.x - x).isZero() && (deepFrame.y - y).isZero();
+}
+
+// picks up a finished deep frame and starts the next one when the view or iterations changed or more of
+// the orbit has arrived. only one frame renders at a time, so the loop never waits
+void updateDeepView() {
+	DeepView view = { x, y, scale, scale, width, height };
+	std::shared_ptr<const OrbitBuffer> orbit = orbitStream().request(view, maxIterations);
+	if (deepFrameJob.valid()) {
+		if (deepFrameJob.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return;
+		deepFrame = deepFrameJob.get();
+		// rows go bottom up in the texture, as the shader's own pass writes them
+		std::vector<unsigned int> rows(deepFrame.iterations.size());
+		for (int py = 0; py < deepFrame.height; py++) {
+			const int* row = &deepFrame.iterations[(size_t)(deepFrame.height - 1 - py) * deepFrame.width];
+			std::copy(row, row + deepFrame.width, rows.begin() + (size_t)py * deepFrame.width);
+		}
+		if (!deepTexture)
+			glGenTextures(1, &deepTexture);
+		glBindTexture(GL_TEXTURE_2D, deepTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, deepFrame.width, deepFrame.height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, rows.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		if (!deepFrame.distances.empty()) {
+			std::vector<float> distanceRows(deepFrame.distances.size());
+			for (int py = 0; py < deepFrame.height; py++) {
+				const float* row = &deepFrame.distances[(size_t)(deepFrame.height - 1 - py) * deepFrame.width];
+				std::copy(row, row + deepFrame.width, distanceRows.begin() + (size_t)py * deepFrame.width);
+			}
+			if (!deepDistanceTexture)
+				glGenTextures(1, &deepDistanceTexture);
+			glBindTexture(GL_TEXTURE_2D, deepDistanceTexture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, deepFrame.width, deepFrame.height, 0, GL_RED, GL_FLOAT, distanceRows.data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		}
+	}
+
+	int published = orbit->published();
+	if (published < 2 || (deepFrameCurrent() && deepFrame.maxIterations == maxIterations && deepFrame.orbitLength == published
+		&& deepFrame.distances.empty() != boundaryShading))
+		return;
+	int iterationCount = maxIterations;
+	bool distance = boundaryShading;
+	deepFrameJob = cpuPool().submit([=]() {
+		DeepFrame frame = { view.centerX, view.centerY, view.scaleY, view.width, view.height, iterationCount, 0, {}, {} };
+		ReferenceOrbit reference = orbit->snapshot();
+		frame.orbitLength = reference.length();
+		frame.iterations.resize((size_t)view.width * view.height);
+		// a single pass against the orbit so far. pixels that outlive it are rebased onto its start, and
+		// exports still do the full glitch correction
+		PerturbationOptions options;
+		options.reference = &reference;
+		options.maxRounds = 1;
+		if (distance) {
+			frame.distances.resize(frame.iterations.size());
+			options.distances = frame.distances.data();
+		}
+		renderPerturbation(view, iterationCount, cpuPool(), frame.iterations.data(), options);
+		return frame;
+	});
+}
+
+std::wstring widen(const std::string& s) {
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+	return converter.from_bytes(s);
+}
+
 std::wstring to_wstring_p(const double val, const int n = 6)
 {
 	std::ostringstream out;
 	out.precision(n);
 	out << std::fixed << val;
 	std::string s = out.str();
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::wstring wide = converter.from_bytes(s);
+	std::wstring wide = widen(s);
 	return wide;
 
 }
 
-int main() {
+// a coordinate with enough digits to tell neighbouring pixels apart at the current scale
+std::wstring coordinateText(const BigFixed& value) {
+	int digits = std::max(20, (int)(-scale.e * 0.30103) + 6);
+	return widen(value.toString(std::min(digits, 32 * value.fractionLimbs()))) + L"    ";
+}
+
+// reads a typed coordinate pair, keeping every digit and at least the view's precision in both parts
+bool parseCoordinate(const std::string& real, const std::string& imaginary, BigFixed& outX, BigFixed& outY) {
+	size_t digits = std::max(real.size(), imaginary.size());
+	int limbs = std::max(BigFixed::limbsForScale(scale), (int)(digits * 3.33 / 32) + 2);
+	return BigFixed::parse(real, limbs, outX) && BigFixed::parse(imaginary, limbs, outY);
+}
+
+// a unit in the last typed digit of a coordinate, how far off it may be from what was meant
+FloatExp typedResolution(const std::string& text) {
+	size_t exponent = text.find_first_of("eE");
+	std::string digits = text.substr(0, exponent);
+	size_t point = digits.find('.');
+	int places = point == std::string::npos ? 0 : (int)(digits.size() - point - 1);
+	int power = exponent == std::string::npos ? 0 : atoi(text.c_str() + exponent + 1);
+	FloatExp resolution = 1.0;
+	FloatExp::parse("1e" + std::to_string(power - places), resolution);
+	return resolution;
+}
+
+// integer command line argument at index i, or fallback if it wasn't given
+int intArg(int argc, char** argv, int i, int fallback) {
+	return i < argc ? atoi(argv[i]) : fallback;
+}
+
+double doubleArg(int argc, char** argv, int i, double fallback) {
+	return i < argc ? atof(argv[i]) : fallback;
+}
+
+// an iteration band at index i, such as 500 for up to 500 iterations or 20-500, or fallback if it wasn't given
+BuddhabrotBand bandArg(int argc, char** argv, int i, BuddhabrotBand fallback) {
+	if (i >= argc)
+		return fallback;
+	const char* dash = strchr(argv[i], '-');
+	if (!dash)
+		return { 0, atoi(argv[i]) };
+	return { atoi(argv[i]), atoi(dash + 1) };
+}
+
+// takes the options that choose the kernel out of the command line, wherever they are, so the positional
+// arguments of every mode stay where they were. false with a message if one of them is invalid
+bool parseKernelOptions(int& argc, char** argv, std::string& error) {
+	int kept = 1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--formula") == 0 && i + 1 < argc) {
+			// --formula mandelbrot|multibrot<power>|burningship|tricorn|<formula for z'>
+			if (!parseFormula(argv[++i], kernelVariant.formula, error))
+				return false;
+		}
+		else if (strcmp(argv[i], "--julia") == 0 && i + 2 < argc) {
+			// --julia <real> <imaginary>
+			kernelVariant.formula.julia = true;
+			kernelVariant.formula.juliaX = atof(argv[++i]);
+			kernelVariant.formula.juliaY = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--single-precision") == 0) {
+			kernelVariant.singlePrecision = true;
+		}
+		else {
+			argv[kept++] = argv[i];
+		}
+	}
+	argc = kept;
+	return true;
+}
+
+int main(int argc, char** argv) {
+	std::string formulaError;
+	if (!parseKernelOptions(argc, argv, formulaError)) {
+		std::cout << "Invalid formula: " << formulaError << std::endl;
+		return -1;
+	}
+	// the high precision modes only know the Mandelbrot set
+	bool deepMode = argc > 1 && (strcmp(argv[1], "--render") == 0 || strcmp(argv[1], "--compare") == 0 || strcmp(argv[1], "--locate") == 0);
+	if (deepMode && !kernelVariant.formula.isMandelbrot()) {
+		std::cout << argv[1] << " only renders the Mandelbrot set" << std::endl;
+		return -1;
+	}
+
+	// headless modes, these never open a window
+	if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+		// --serve [port] [threads]
+		TileServerOptions options;
+		options.port = intArg(argc, argv, 2, options.port);
+		options.threads = intArg(argc, argv, 3, 0);
+		options.variant = kernelVariant;
+		return runTileServer(options);
+	}
+	if (argc > 1 && strcmp(argv[1], "--loadtest") == 0) {
+		// --loadtest [port] [requests] [concurrency] [max zoom] [iterations]
+		return runTileLoadTest(intArg(argc, argv, 2, 8080), intArg(argc, argv, 3, 2000), intArg(argc, argv, 4, 16),
+			intArg(argc, argv, 5, 6), intArg(argc, argv, 6, 256));
+	}
+	if (argc > 1 && strcmp(argv[1], "--benchmark-tiles") == 0) {
+		// --benchmark-tiles [real] [imaginary] [scale] [width] [height] [iterations] [frames]
+		// the CPU renderers' tile scheduling against the static and row order splits it replaced
+		FrameView view = { doubleArg(argc, argv, 2, -0.75), doubleArg(argc, argv, 3, 0.1), doubleArg(argc, argv, 4, 0.3),
+			intArg(argc, argv, 5, 1280), intArg(argc, argv, 6, 720), intArg(argc, argv, 7, 2000) };
+		benchmarkTileScheduling(view, kernelVariant, std::max(1, intArg(argc, argv, 8, 5)), cpuPool());
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--benchmark-numa") == 0) {
+		// --benchmark-numa [real] [imaginary] [scale] [width] [height] [iterations] [frames]
+		// how the CPU renderers scale from one NUMA node to all of them, with and without placement
+		FrameView view = { doubleArg(argc, argv, 2, -0.75), doubleArg(argc, argv, 3, 0.1), doubleArg(argc, argv, 4, 0.3),
+			intArg(argc, argv, 5, 1920), intArg(argc, argv, 6, 1080), intArg(argc, argv, 7, 2000) };
+		benchmarkNumaScaling(view, kernelVariant, std::max(1, intArg(argc, argv, 8, 5)));
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "--benchmark-layout") == 0) {
+		// --benchmark-layout [real] [imaginary] [scale] [width] [height] [iterations] [frames]
+		// the CPU renderers' tile major counts against the row major counts they replaced
+		FrameView view = { doubleArg(argc, argv, 2, -0.75), doubleArg(argc, argv, 3, 0.1), doubleArg(argc, argv, 4, 0.3),
+			intArg(argc, argv, 5, 1920), intArg(argc, argv, 6, 1080), intArg(argc, argv, 7, 2000) };
+		benchmarkCountLayout(view, kernelVariant, std::max(1, intArg(argc, argv, 8, 5)));
+		return 0;
+	}
+	if (argc > 2 && strcmp(argv[1], "--dzi") == 0) {
+		// --dzi <name> [real] [imaginary] [scale] [width] [height] [iterations] [tile size]
+		DziOptions options;
+		options.name = argv[2];
+		options.centerX = doubleArg(argc, argv, 3, options.centerX);
+		options.centerY = doubleArg(argc, argv, 4, options.centerY);
+		options.scale = doubleArg(argc, argv, 5, options.scale);
+		options.width = intArg(argc, argv, 6, options.width);
+		options.height = intArg(argc, argv, 7, options.height);
+		options.maxIterations = intArg(argc, argv, 8, options.maxIterations);
+		options.tileSize = intArg(argc, argv, 9, options.tileSize);
+		options.variant = kernelVariant;
+		return exportDzi(options);
+	}
+	if (argc > 1 && (strcmp(argv[1], "--buddhabrot") == 0 || strcmp(argv[1], "--benchmark-buddhabrot") == 0)) {
+		if (!kernelVariant.formula.isMandelbrot()) {
+			std::cout << "The Buddhabrot is only rendered for the Mandelbrot set" << std::endl;
+			return 1;
+		}
+		BuddhabrotOptions options;
+		if (strcmp(argv[1], "--benchmark-buddhabrot") == 0) {
+			// --benchmark-buddhabrot [samples]
+			// samples a second from one thread up to every hardware thread
+			options.samples = argc > 2 ? atoll(argv[2]) : 5000000;
+			benchmarkBuddhabrot(options);
+			return 0;
+		}
+		// --buddhabrot <file> [real] [imaginary] [scale] [width] [height] [samples] [red] [green] [blue] [uniform]
+		// each channel takes an iteration band, such as 5000, 500 and 50 for a Nebulabrot
+		if (argc < 3) {
+			std::cout << "--buddhabrot needs a file to write" << std::endl;
+			return 1;
+		}
+		options.file = argv[2];
+		options.centerX = doubleArg(argc, argv, 3, options.centerX);
+		options.centerY = doubleArg(argc, argv, 4, options.centerY);
+		options.scale = doubleArg(argc, argv, 5, options.scale);
+		options.width = intArg(argc, argv, 6, options.width);
+		options.height = intArg(argc, argv, 7, options.height);
+		options.samples = argc > 8 ? atoll(argv[8]) : options.samples;
+		for (int c = 0; c < 3; c++)
+			options.bands[c] = bandArg(argc, argv, 9 + c, options.bands[c]);
+		options.metropolis = !(argc > 12 && strcmp(argv[12], "uniform") == 0);
+		return exportBuddhabrot(options);
+	}
+	if (argc > 5 && strcmp(argv[1], "--render") == 0) {
+		// --render <file> <real> <imaginary> <scale> [width] [height] [iterations]
+		// the coordinates are read in full precision, so this works at any depth
+		// the scale may be far smaller than a double can hold, such as 1e-1000
+		FloatExp viewScale;
+		bool validScale = FloatExp::parse(argv[5], viewScale) && viewScale > 0.0;
+		int limbs = BigFixed::limbsForScale(viewScale);
+		DeepView view = { BigFixed(limbs), BigFixed(limbs), 0.0, viewScale, intArg(argc, argv, 6, 1280), intArg(argc, argv, 7, 720) };
+		view.scaleX = viewScale * ((double)view.width / view.height);
+		if (!BigFixed::parse(argv[3], limbs, view.centerX) || !BigFixed::parse(argv[4], limbs, view.centerY) || !validScale
+			|| view.width < 1 || view.height < 1) {
+			std::cout << "Invalid view" << std::endl;
+			return -1;
+		}
+		return saveDeepImage(argv[2], view, intArg(argc, argv, 8, 1000));
+	}
+	if (argc > 4 && strcmp(argv[1], "--compare") == 0) {
+		// --compare <real> <imaginary> <scale> [width] [height] [iterations]
+		// renders a view with perturbation and again directly in Fixed128, and reports where they disagree
+		FloatExp viewScale;
+		bool validScale = FloatExp::parse(argv[4], viewScale) && viewScale > 0.0;
+		int limbs = BigFixed::limbsForScale(viewScale);
+		DeepView view = { BigFixed(limbs), BigFixed(limbs), 0.0, viewScale, intArg(argc, argv, 5, 640), intArg(argc, argv, 6, 360) };
+		view.scaleX = viewScale * ((double)view.width / view.height);
+		int iterationCount = intArg(argc, argv, 7, 1000);
+		if (!BigFixed::parse(argv[2], limbs, view.centerX) || !BigFixed::parse(argv[3], limbs, view.centerY) || !validScale
+			|| view.width < 1 || view.height < 1 || !fixed128Resolves(view)) {
+			std::cout << "Invalid view, the scale has to be at least " << FIXED128_SCALE << std::endl;
+			return -1;
+		}
+		std::vector<int> perturbed((size_t)view.width * view.height), direct(perturbed.size());
+		auto start = std::chrono::steady_clock::now();
+		PerturbationStats stats = renderPerturbation(view, iterationCount, cpuPool(), perturbed.data());
+		auto middle = std::chrono::steady_clock::now();
+		renderFixed128(view, iterationCount, cpuPool(), direct.data());
+		auto end = std::chrono::steady_clock::now();
+		long long mismatched = 0, worst = 0;
+		for (size_t i = 0; i < direct.size(); i++) {
+			if (perturbed[i] != direct[i]) {
+				mismatched++;
+				worst = std::max(worst, (long long)abs(perturbed[i] - direct[i]));
+			}
+		}
+		std::cout << "perturbation: " << std::chrono::duration<double>(middle - start).count() << " s, "
+			<< stats.references << " references" << std::endl;
+		std::cout << "reference orbits: " << stats.orbitSteps << " steps in " << stats.orbitBytes / 1024 << " KB, "
+			<< stats.orbitSteps * 16 / 1024 << " KB as doubles" << std::endl;
+		std::cout << "fixed128: " << std::chrono::duration<double>(end - middle).count() << " s" << std::endl;
+		std::cout << mismatched << " of " << direct.size() << " pixels differ, by at most " << worst << " iterations" << std::endl;
+
+		// both again with distance estimates, for what carrying the derivative costs. the counts mustn't change
+		std::vector<int> perturbedDistance(perturbed.size()), directDistance(perturbed.size());
+		std::vector<float> distances(perturbed.size());
+		PerturbationOptions distanceOptions;
+		distanceOptions.distances = distances.data();
+		auto distanceStart = std::chrono::steady_clock::now();
+		renderPerturbation(view, iterationCount, cpuPool(), perturbedDistance.data(), distanceOptions);
+		auto distanceMiddle = std::chrono::steady_clock::now();
+		renderFixed128(view, iterationCount, cpuPool(), directDistance.data(), distances.data());
+		auto distanceEnd = std::chrono::steady_clock::now();
+		double perturbationRatio = std::chrono::duration<double>(distanceMiddle - distanceStart).count() / std::chrono::duration<double>(middle - start).count();
+		double fixed128Ratio = std::chrono::duration<double>(distanceEnd - distanceMiddle).count() / std::chrono::duration<double>(end - middle).count();
+		bool unchanged = perturbedDistance == perturbed && directDistance == direct;
+		std::cout << "with distance estimates: perturbation " << perturbationRatio << "x as long, fixed128 "
+			<< fixed128Ratio << "x" << (unchanged ? ", iterations unchanged" : ", iterations changed") << std::endl;
+		return mismatched > 0 || !unchanged ? 1 : 0;
+	}
+	if (argc > 4 && strcmp(argv[1], "--locate") == 0) {
+		// --locate <real> <imaginary> <radius> [iterations] [nucleus|misiurewicz]
+		// finds the minibrot or Misiurewicz point nearest a rough location and prints its exact coordinates,
+		// ready to pass to --render
+		FloatExp radius;
+		bool validRadius = FloatExp::parse(argv[4], radius) && radius > 0.0;
+		int limbs = BigFixed::limbsForScale(radius);
+		BigFixed cx(limbs), cy(limbs);
+		if (!BigFixed::parse(argv[2], limbs, cx) || !BigFixed::parse(argv[3], limbs, cy) || !validRadius) {
+			std::cout << "Invalid location" << std::endl;
+			return -1;
+		}
+		int iterationCount = intArg(argc, argv, 5, autoIterationCeiling);
+		ZoomTarget target = argc > 6 && strcmp(argv[6], "misiurewicz") == 0
+			? locateMisiurewicz(cx, cy, radius, iterationCount) : locateNucleus(cx, cy, radius, iterationCount);
+		if (!target.found) {
+			std::cout << "Nothing found within " << radius.toString() << std::endl;
+			return 1;
+		}
+		if (target.misiurewicz)
+			std::cout << "misiurewicz point of preperiod " << target.preperiod << " and period " << target.period << std::endl;
+		else
+			std::cout << "nucleus of period " << target.period << ", size " << target.size.toString() << std::endl;
+		std::cout << target.x.toExactString() << " " << target.y.toExactString() << std::endl;
+		return 0;
+	}
+
+	// interactive options
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--auto-iterations") == 0) {
+			// --auto-iterations [ceiling]
+			autoIterations = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				autoIterationCeiling = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--renderer") == 0 && i + 1 < argc) {
+			// --renderer gpu|compute|cpu|simd|hybrid
+			if (!parseBackend(argv[++i], backend)) {
+				std::cout << "Unknown renderer " << argv[i] << ", expected gpu, compute, cpu, simd or hybrid" << std::endl;
+				return -1;
+			}
+		}
+	}
+	// the renderer benchmark needs a context, so it runs once the window is up
+	bool benchmarkMode = argc > 1 && strcmp(argv[1], "--benchmark-renderers") == 0;
+
 	if (!glfwInit())
 		return -1; // error!
 
-	GLFWwindow* window = glfwCreateWindow(640, 480, "Mandelbrot Set", NULL, NULL);
+	std::string title = kernelVariant.formula.isMandelbrot() ? "Mandelbrot Set" : kernelVariant.formula.name();
+	GLFWwindow* window = glfwCreateWindow(640, 480, title.c_str(), NULL, NULL);
 	if (!window) {
 		return -1; // error!
 	}
@@ -137,61 +664,21 @@ int main() {
 	glfwSetScrollCallback(window, scroll_callback);
 
 	// SET UP SHADERS
-	unsigned int vsId = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fsId = glCreateShader(GL_FRAGMENT_SHADER);
-
-	std::ifstream vsFile, fsFile;
-	std::string vsCode, fsCode;
-	vsFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fsFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try {
-		vsFile.open("vertexShader.glsl");
-		fsFile.open("fragmentShader.glsl");
-		std::stringstream vsStream;
-		std::stringstream fsStream;
-		vsStream << vsFile.rdbuf();
-		fsStream << fsFile.rdbuf();
-		vsFile.close();
-		fsFile.close();
-		vsCode = vsStream.str();
-		fsCode = fsStream.str();
-	}
-	catch (std::ifstream::failure e) {
-		std::cout << "Error reading shader files" << std::endl;
+	// the iterate pass advances per pixel orbits into textures, the color pass turns the counts into the frame.
+	// iterate passes are built in the background as their variants are needed, starting with the ones this
+	// formula can switch to, and after the first run they load from the saved binaries
+	std::unique_ptr<ProgramCache> programs(new ProgramCache(window, "shaders"));
+	for (int i = 0; i < 4; i++) {
+		KernelVariant variant = kernelVariant;
+		variant.interiorCheck = (i & 1) != 0;
+		bool distance = (i & 2) != 0;
+		if (distance && !kernelVariant.formula.isMandelbrot())
+			continue;
+		variant.singlePrecision = variant.singlePrecision && !distance;
+		programs->request(VERTEX_SHADER, ITERATE_SHADER, shaderDefines(variant, distance));
 	}
+	ColorPass colorPass(programs->wait(VERTEX_SHADER, FRAGMENT_SHADER));
 
-	const char* vsCodePointer = vsCode.c_str();
-	glShaderSource(vsId, 1, &vsCodePointer, NULL);
-	const char* fsCodePointer = fsCode.c_str();
-	glShaderSource(fsId, 1, &fsCodePointer, NULL);
-
-	glCompileShader(vsId);
-	// get any error messages
-	int success;
-	char infoLog[512];
-	unsigned int shaders[2] = { vsId, fsId };
-	for (unsigned int shader : shaders) {
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-		if (!success) {
-			glGetShaderInfoLog(vsId, 512, NULL, infoLog);
-			std::cout << infoLog << std::endl;
-		}
-	}
-
-	glCompileShader(fsId);
-
-	unsigned int program = glCreateProgram();
-	glAttachShader(program, vsId);
-	glAttachShader(program, fsId);
-	glLinkProgram(program);
-
-	glDetachShader(program, vsId);
-	glDetachShader(program, fsId);
-
-	glDeleteShader(vsId);
-	glDeleteShader(fsId);
-
-	glUseProgram(program);
 	unsigned int vbo;
 	glGenBuffers(1, &vbo);
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -208,6 +695,27 @@ int main() {
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
+	if (benchmarkMode) {
+		// --benchmark-renderers [real] [imaginary] [scale] [width] [height] [iterations] [frames]
+		FrameView view = { doubleArg(argc, argv, 2, -0.75), doubleArg(argc, argv, 3, 0.1), doubleArg(argc, argv, 4, 0.3),
+			intArg(argc, argv, 5, 1280), intArg(argc, argv, 6, 720), intArg(argc, argv, 7, 2000) };
+		KernelVariant variant = kernelVariant;
+		variant.interiorCheck = autoIterations;
+		benchmarkRenderers(view, variant, std::max(1, intArg(argc, argv, 8, 5)), *programs, cpuPool());
+		programs.reset();
+		glfwTerminate();
+		return 0;
+	}
+
+	// every backend that runs here, made up front so switching keeps what each has computed
+	std::unique_ptr<Renderer> renderers[BACKEND_COUNT];
+	for (int i = 0; i < BACKEND_COUNT; i++)
+		renderers[i] = makeRenderer((Backend)i, *programs, cpuPool());
+	if (!renderers[(int)backend]) {
+		std::cout << "The " << backendName(backend) << " renderer isn't supported by this driver" << std::endl;
+		backend = Backend::GPU_FRAGMENT;
+	}
+
 	COORD topLeft = { 0, 0 };
 	HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
 	CONSOLE_SCREEN_BUFFER_INFO screen;
@@ -218,21 +726,41 @@ int main() {
 
 	auto last = std::chrono::high_resolution_clock::now();
 	while (!glfwWindowShouldClose(window)) {
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		// this will run our shader, so begin timing here
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
 		glfwGetFramebufferSize(window, &width, &height);
 		glViewport(0, 0, width, height);
 
-		GLuint resLocation = glGetUniformLocation(program, "resolution");
-		glUniform2d(resLocation, width, height);
-		GLuint centerLocation = glGetUniformLocation(program, "centerPosition");
-		glUniform2d(centerLocation, x, y);
-		GLuint sizeLocation = glGetUniformLocation(program, "scale");
-		glUniform1d(sizeLocation, scale);
-		glUniform1i(glGetUniformLocation(program, "maxIterations"), maxIterations);
+		// false while the GPU is still taking a render of many iterations a pass a frame
+		bool frameComplete = true;
+		// this will run our shaders, so begin timing here
+		if (width > 0 && height > 0) {
+			// past the shader's precision the CPU renders the view, and the shader's render stands in as a
+			// preview until a frame of the current view is ready. rendered zooms export their own frames
+			bool deep = !zooming && scale < PERTURBATION_SCALE && kernelVariant.formula.isMandelbrot();
+			if (deep)
+				updateDeepView();
+			unsigned int iterationTexture = deepTexture;
+			unsigned int distanceTexture = deepFrame.distances.empty() ? 0 : deepDistanceTexture;
+			int reachedIterations = maxIterations;
+			if (!deep || !deepFrameCurrent()) {
+				// the GPU backends only do work for pixels that haven't escaped yet when maxIterations goes up.
+				// distance estimates are only carried for the Mandelbrot set, in doubles
+				bool distance = boundaryShading;
+				KernelVariant variant = kernelVariant;
+				variant.interiorCheck = autoIterations;
+				FrameView view = { x.toDouble(), y.toDouble(), scale.toDouble(), width, height, maxIterations };
+				Renderer& renderer = *renderers[(int)backend];
+				renderer.render(view, variant, distance);
+				iterationTexture = renderer.iterationTexture();
+				distanceTexture = distance ? renderer.distanceTexture() : 0;
+				reachedIterations = renderer.reachedIterations();
+				frameComplete = reachedIterations >= maxIterations;
+			}
+
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(0, 0, width, height);
+			glClear(GL_COLOR_BUFFER_BIT);
+			colorPass.draw(iterationTexture, boundaryShading ? distanceTexture : 0, maxIterations, reachedIterations);
+		}
 
 		int state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
 		glfwGetCursorPos(window, &mx, &my);
@@ -254,17 +782,32 @@ int main() {
 			fpsBuffer.erase(fpsBuffer.begin());
 		}
 
+		if (autoIterations)
+			updateAutoIterations();
+		// a probe still running when auto mode went off is of a view or ceiling that may be gone by the
+		// time it comes back on, so it is dropped, and the view is probed afresh once it is back on. the
+		// pool finishes it, but nothing reads the result
+		else {
+			if (iterationProbe.valid())
+				iterationProbe = std::future<int>();
+			probedIterations = 0;
+		}
+
 		if (!zooming) {
 			WriteConsoleOutputCharacter(console, L"MANDELBROT EXPLORER", 19, { 2, 1 }, &written);
-			std::wstring fields[6 ] = {
-				L"MAX_ITERATIONS:  " + std::to_wstring(maxIterations),
+			std::wstring fields[10] = {
+				L"MAX_ITERATIONS:  " + std::to_wstring(maxIterations) + L"        ",
+				autoIterations ? L"AUTO ITERATIONS: ON " : L"AUTO ITERATIONS: OFF",
 				L"RENDER_TIME: " + std::to_wstring(elapsed),
 				L"FPS: " + to_wstring_p(rollingFPSSum / fpsBuffer.size(), 2),
-				L"REAL: " + to_wstring_p(mx / width * 2 * scale + (x - scale), 20),
-				L"IMAGINARY: " + to_wstring_p((height - my) / height * 2 * scale + (y - scale), 20),
-				L"SCALE: " + to_wstring_p(scale, 20)
+				L"REAL: " + coordinateText(x + BigFixed::fromFloatExp(cursorOffsetX(), x.fractionLimbs())),
+				L"IMAGINARY: " + coordinateText(y + BigFixed::fromFloatExp(cursorOffsetY(), y.fractionLimbs())),
+				L"SCALE: " + widen(scale.toString()) + L"        ",
+				antialias ? L"ANTIALIASED EXPORT: ON " : L"ANTIALIASED EXPORT: OFF",
+				boundaryShading ? L"BOUNDARY SHADING: ON " : L"BOUNDARY SHADING: OFF",
+				L"RENDERER: " + widen(renderers[(int)backend]->status()) + L"        "
 			};
-			for (int i = 0; i < 6; i++) {
+			for (int i = 0; i < 10; i++) {
 				WriteConsoleOutputCharacter(console, fields[i].c_str(), fields[i].length(), { (SHORT)3, (SHORT)3 + (SHORT)i }, &written);
 			}
 
@@ -272,24 +815,56 @@ int main() {
 				L"LEFT CLICK + DRAG: PAN",
 				L"SCROLL: ZOOM",
 				L"UP KEY: INCREASE ITERATIONS",
-				L"DOWN KEY: INCREASE ITERATIONS",
+				L"DOWN KEY: DECREASE ITERATIONS",
+				L"I: TOGGLE AUTOMATIC ITERATIONS",
 				L"R: BEGIN A RENDERED ZOOM",
+				L"A: TOGGLE ANTIALIASED EXPORT",
+				L"D: TOGGLE BOUNDARY SHADING",
+				L"B: SWITCH RENDERER",
 				L"ESC: STOP ZOOM"
 			};
-			WriteConsoleOutputCharacter(console, L"CONTROLS", 8, { 2, 10 }, &written);
-			for (int i = 0; i < 6; i++) {
-				WriteConsoleOutputCharacter(console, controls[i].c_str(), controls[i].length(), { (SHORT)3, (SHORT)12 + (SHORT)i }, &written);
+			WriteConsoleOutputCharacter(console, L"CONTROLS", 8, { 2, 14 }, &written);
+			for (int i = 0; i < (int)(sizeof(controls) / sizeof(controls[0])); i++) {
+				WriteConsoleOutputCharacter(console, controls[i].c_str(), controls[i].length(), { (SHORT)3, (SHORT)16 + (SHORT)i }, &written);
 			}
 
+			// adjusting the iterations by hand takes over from the automatic choice
 			if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
 			{
 				maxIterations++;
+				autoIterations = false;
 			}
 
 			if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-				maxIterations--;
+				maxIterations = std::max(maxIterations - 1, 1);
+				autoIterations = false;
 			}
 
+			bool iDown = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+			if (iDown && !autoKeyDown)
+				autoIterations = !autoIterations;
+			autoKeyDown = iDown;
+
+			// toggle on the press only, not every frame the key is held
+			bool aDown = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+			if (aDown && !antialiasKeyDown)
+				antialias = !antialias;
+			antialiasKeyDown = aDown;
+
+			bool dDown = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+			if (dDown && !boundaryKeyDown)
+				boundaryShading = !boundaryShading;
+			boundaryKeyDown = dDown;
+
+			// the next backend this driver has
+			bool bDown = glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS;
+			if (bDown && !backendKeyDown) {
+				do {
+					backend = (Backend)(((int)backend + 1) % BACKEND_COUNT);
+				} while (!renderers[(int)backend]);
+			}
+			backendKeyDown = bDown;
+
 			if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
 				zooming = true;
 
@@ -302,49 +877,95 @@ int main() {
 				std::cout << std::endl;
 				std::cout << "ZOOM LOCATION:" << std::endl;
 				// get zoom location
+				// read as text so that every typed digit is kept
+				std::string real, imaginary;
 				std::cout << "  REAL: ";
-				std::cin >> zoomLocation[0];
+				std::cin >> real;
 				std::cout << "  IMAGINARY: ";
-				std::cin >> zoomLocation[1];
-				if (zoomLocation[0] == 0 && zoomLocation[1] == 0) {
-					zoomLocation[0] = mx / width * scale * 2 + (x - scale);
-					zoomLocation[1] = (height - my) / height * scale * 2 + (y - scale);
+				std::cin >> imaginary;
+				FloatExp searchRadius = std::max(typedResolution(real), typedResolution(imaginary));
+				if (!parseCoordinate(real, imaginary, zoomLocation[0], zoomLocation[1])
+					|| (zoomLocation[0].isZero() && zoomLocation[1].isZero())) {
+					zoomLocation[0] = x + BigFixed::fromFloatExp(cursorOffsetX(), x.fractionLimbs());
+					zoomLocation[1] = y + BigFixed::fromFloatExp(cursorOffsetY(), y.fractionLimbs());
+					// a few pixels around the cursor
+					searchRadius = scale * (8.0 / height);
+				}
+
+				// snap to the nearest feature, so the dive ends somewhere
+				std::cout << "  TARGET (N: NEAREST MINIBROT, M: NEAREST MISIUREWICZ POINT, ANYTHING ELSE: THIS EXACT LOCATION): ";
+				std::string kind;
+				std::cin >> kind;
+				bool nucleus = kind == "N" || kind == "n", misiurewicz = kind == "M" || kind == "m";
+				ZoomTarget target;
+				if (nucleus)
+					target = locateNucleus(zoomLocation[0], zoomLocation[1], searchRadius, autoIterationCeiling);
+				else if (misiurewicz)
+					target = locateMisiurewicz(zoomLocation[0], zoomLocation[1], searchRadius, autoIterationCeiling);
+				zoomEnd = 0.0;
+				zoomTargetText = nucleus || misiurewicz ? L"TARGET: NOTHING FOUND NEARBY" : L"TARGET: AS GIVEN";
+				if (target.found) {
+					zoomLocation[0] = target.x;
+					zoomLocation[1] = target.y;
+					if (target.misiurewicz) {
+						zoomTargetText = L"TARGET: MISIUREWICZ POINT, PREPERIOD " + std::to_wstring(target.preperiod) + L" PERIOD " + std::to_wstring(target.period);
+					}
+					else {
+						zoomEnd = target.size;
+						zoomTargetText = L"TARGET: MINIBROT OF PERIOD " + std::to_wstring(target.period) + L", SIZE " + widen(target.size.toString());
+					}
 				}
 				scale = 1.0;
 				x = zoomLocation[0];
 				y = zoomLocation[1];
+				fitPrecision();
 				zoomIndex = 0;
+				frameLog.open("render/frames.txt");
+				frameLog << "# frame real imaginary scale iterations width height, both axes spanning [-scale, scale]" << std::endl;
 
 				clear_console(console);
 			}
 		}
 		else {
-			if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS || scale < 0.0000000000000002) {
+			if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS || scale < zoomEnd) {
 				zooming = false;
+				frameLog.close();
 				clear_console(console);
 			}
 
 
-			zoom(zoomLocation[0], zoomLocation[1], 0.99);
-			
-			saveImage(("render/" + std::to_string(zoomIndex) + ".png").c_str(), window);
-			zoomIndex++;
+			// a frame the GPU is still working through waits for its last pass before it is saved
+			if (frameComplete) {
+				zoom((zoomLocation[0].withPrecision(x.fractionLimbs()) - x).toFloatExp(),
+					(zoomLocation[1].withPrecision(y.fractionLimbs()) - y).toFloatExp(), 0.99);
+
+				saveImage(("render/" + std::to_string(zoomIndex) + ".png").c_str(), window);
+				// the exact view of every frame, enough to render it again
+				frameLog << zoomIndex << " " << x.toExactString() << " " << y.toExactString() << " " << scale.toString() << " "
+					<< maxIterations << " " << width << " " << height << std::endl;
+				zoomIndex++;
+			}
 			
 			WriteConsoleOutputCharacter(console, L"MANDELBROT EXPLORER", 19, { 2, 1 }, &written);
-			std::wstring fields[6] = {
-				L"MAX_ITERATIONS:  " + std::to_wstring(maxIterations),
+			std::wstring fields[9] = {
+				L"MAX_ITERATIONS:  " + std::to_wstring(maxIterations) + L"        ",
+				autoIterations ? L"AUTO ITERATIONS: ON " : L"AUTO ITERATIONS: OFF",
 				L"RENDER_TIME: " + std::to_wstring(elapsed),
 				L"FPS: " + to_wstring_p(rollingFPSSum / fpsBuffer.size(), 2),
-				L"REAL: " + to_wstring_p(zoomLocation[0], 20),
-				L"IMAGINARY: " + to_wstring_p(zoomLocation[1], 20),
-				L"SCALE: " + to_wstring_p(scale, 20)
+				L"REAL: " + coordinateText(zoomLocation[0]),
+				L"IMAGINARY: " + coordinateText(zoomLocation[1]),
+				L"SCALE: " + widen(scale.toString()) + L"        ",
+				antialias ? L"SAMPLES PER PIXEL: " + to_wstring_p(antialiasStats.samplesPerPixel, 2) + L" (" + to_wstring_p(antialiasStats.refinedFraction * 100, 1) + L"% REFINED)" : L"ANTIALIASED EXPORT: OFF",
+				zoomTargetText
 			};
-			for (int i = 0; i < 6; i++) {
+			for (int i = 0; i < 9; i++) {
 				WriteConsoleOutputCharacter(console, fields[i].c_str(), fields[i].length(), { (SHORT)3, (SHORT)3 + (SHORT)i }, &written);
 			}
 		}
 	}
 
+	// its hidden context has to go before GLFW does
+	programs.reset();
 	glfwTerminate();
 
 	return 0;
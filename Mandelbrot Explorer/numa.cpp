@@ -0,0 +1,177 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef _WIN32
+	struct Topology {
+		std::vector<GROUP_AFFINITY> nodes;
+
+		Topology() {
+			ULONG highest = 0;
+			if (GetNumaHighestNodeNumber(&highest)) {
+				for (USHORT node = 0; node <= highest; node++) {
+					GROUP_AFFINITY affinity = {};
+					// numbers can have gaps, and a node can have no processors
+					if (GetNumaNodeProcessorMaskEx(node, &affinity) && affinity.Mask != 0)
+						nodes.push_back(affinity);
+				}
+			}
+			if (nodes.empty()) {
+				GROUP_AFFINITY all = {};
+				all.Mask = ~(KAFFINITY)0;
+				nodes.push_back(all);
+			}
+		}
+	};
+#else
+	struct Topology {
+		std::vector<std::vector<int>> nodes; // processor numbers
+
+		Topology() {
+			for (int node = 0;; node++) {
+				std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+				std::string list;
+				if (!std::getline(file, list))
+					break;
+				// such as 0-15,32-47
+				std::vector<int> processors;
+				std::istringstream ranges(list);
+				std::string range;
+				while (std::getline(ranges, range, ',')) {
+					int first = atoi(range.c_str()), last = first;
+					size_t dash = range.find('-');
+					if (dash != std::string::npos)
+						last = atoi(range.c_str() + dash + 1);
+					for (int p = first; p <= last; p++)
+						processors.push_back(p);
+				}
+				if (!processors.empty())
+					nodes.push_back(processors);
+			}
+			if (nodes.empty())
+				nodes.push_back({});
+		}
+	};
+#endif
+
+	const Topology& topology() {
+		static Topology instance;
+		return instance;
+	}
+}
+
+int numaNodeCount() {
+	return (int)topology().nodes.size();
+}
+
+#ifdef _WIN32
+int numaNodeProcessors(int node) {
+	KAFFINITY mask = topology().nodes[node].Mask;
+	int count = 0;
+	for (; mask; mask &= mask - 1)
+		count++;
+	return numaNodeCount() == 1 ? (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS) : count;
+}
+
+void pinToNumaNode(int node) {
+	if (numaNodeCount() > 1)
+		SetThreadGroupAffinity(GetCurrentThread(), &topology().nodes[node], NULL);
+}
+
+int currentNumaNode() {
+	PROCESSOR_NUMBER processor;
+	GetCurrentProcessorNumberEx(&processor);
+	USHORT number = 0;
+	if (!GetNumaProcessorNodeEx(&processor, &number))
+		return 0;
+	// the index among nodes with processors, which skips any gaps in the numbering
+	const std::vector<GROUP_AFFINITY>& nodes = topology().nodes;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].Group == processor.Group && (nodes[i].Mask & ((KAFFINITY)1 << processor.Number)))
+			return (int)i;
+	}
+	return 0;
+}
+
+void* reserveMemory(size_t bytes) {
+	return VirtualAlloc(NULL, bytes, MEM_RESERVE, PAGE_READWRITE);
+}
+
+void releaseMemory(void* memory, size_t) {
+	if (memory)
+		VirtualFree(memory, 0, MEM_RELEASE);
+}
+
+bool placeOnNumaNode(void* memory, size_t bytes, int node) {
+	if (node < 0 || numaNodeCount() == 1)
+		return VirtualAlloc(memory, bytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+	// the OS's number of the node, not its index here, from the node's first processor
+	const GROUP_AFFINITY& affinity = topology().nodes[node];
+	PROCESSOR_NUMBER processor = { affinity.Group, 0, 0 };
+	while (!(affinity.Mask & ((KAFFINITY)1 << processor.Number)))
+		processor.Number++;
+	USHORT number = 0;
+	GetNumaProcessorNodeEx(&processor, &number);
+	// committing a page that is already committed leaves it where it is. a node out of memory hands it anywhere
+	if (VirtualAllocExNuma(GetCurrentProcess(), memory, bytes, MEM_COMMIT, PAGE_READWRITE, number))
+		return true;
+	return VirtualAlloc(memory, bytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+}
+#else
+int numaNodeProcessors(int node) {
+	int count = (int)topology().nodes[node].size();
+	return count > 0 ? count : std::max(1, (int)sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+void pinToNumaNode(int node) {
+	if (numaNodeCount() == 1)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int processor : topology().nodes[node])
+		CPU_SET(processor, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int currentNumaNode() {
+	int processor = sched_getcpu();
+	const std::vector<std::vector<int>>& nodes = topology().nodes;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (std::find(nodes[i].begin(), nodes[i].end(), processor) != nodes[i].end())
+			return (int)i;
+	}
+	return 0;
+}
+
+void* reserveMemory(size_t bytes) {
+	// mapped pages only get memory once touched, on the node of the thread that touches them
+	void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return memory == MAP_FAILED ? nullptr : memory;
+}
+
+void releaseMemory(void* memory, size_t bytes) {
+	if (memory)
+		munmap(memory, bytes);
+}
+
+bool placeOnNumaNode(void*, size_t, int) {
+	return false;
+}
+#endif
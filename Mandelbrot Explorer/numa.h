@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+// the machine's NUMA nodes, for placing the CPU engine's threads and buffers. a machine without NUMA, or
+// an OS this doesn't know, is one node holding every processor
+int numaNodeCount();
+
+// processors of a node, to size a pool that only uses some of the nodes
+int numaNodeProcessors(int node);
+
+// keeps the calling thread on the processors of node. the OS still picks which of them
+void pinToNumaNode(int node);
+
+// the node of the processor the calling thread is running on now
+int currentNumaNode();
+
+// address space for bytes of memory that isn't placed anywhere yet, page aligned
+void* reserveMemory(size_t bytes);
+void releaseMemory(void* memory, size_t bytes);
+// puts the pages of part of reserved memory on node, or anywhere for node -1, and false where the OS leaves
+// that to whichever thread touches them first, which the caller then does from node. pages shared with a
+// neighbouring range stay where they were put first
+bool placeOnNumaNode(void* memory, size_t bytes, int node);
@@ -0,0 +1,295 @@
+#include "orbitCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char MAGIC[8] = "MBORBIT";
+// bump when the layout changes, files of other versions are ignored and computed again
+static const uint32_t VERSION = 2;
+
+namespace {
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t limbs;
+		uint32_t length;
+		uint32_t escaped;
+		uint32_t waypoints;
+	};
+
+	const size_t WAYPOINT_BYTES = 2 * sizeof(double);
+
+	size_t numberBytes(int limbs) {
+		return (limbs + 2) * sizeof(uint32_t);
+	}
+
+	size_t orbitOffset(int limbs) {
+		return sizeof(Header) + 4 * numberBytes(limbs);
+	}
+
+	// a 64 bit seek, long is only 32 bits on Windows and long orbits pass 2 GB
+	bool seek(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+		return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+		return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+	}
+
+	// read only view of a whole file
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path) {
+#ifdef _WIN32
+			file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			LARGE_INTEGER size;
+			if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+				return;
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping == NULL)
+				return;
+			bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if (bytes)
+				length = (size_t)size.QuadPart;
+#else
+			file = open(path.c_str(), O_RDONLY);
+			struct stat info;
+			if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+				return;
+			void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (view == MAP_FAILED)
+				return;
+			bytes = (const unsigned char*)view;
+			length = (size_t)info.st_size;
+#endif
+		}
+
+		~MappedFile() {
+#ifdef _WIN32
+			if (bytes)
+				UnmapViewOfFile(bytes);
+			if (mapping != NULL)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (bytes)
+				munmap((void*)bytes, length);
+			if (file >= 0)
+				close(file);
+#endif
+		}
+
+		const unsigned char* data() const { return bytes; }
+		size_t size() const { return length; }
+
+	private:
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#else
+		int file = -1;
+#endif
+		const unsigned char* bytes = nullptr;
+		size_t length = 0;
+	};
+
+	void writeNumber(FILE* file, const BigFixed& value, int limbs) {
+		BigFixed number = value.withPrecision(limbs);
+		uint32_t words[2] = { number.isNegative() ? 1u : 0u };
+		fwrite(words, sizeof(uint32_t), 1, file);
+		for (int l = 0; l <= limbs; l++) {
+			uint32_t limb = number.limb(l);
+			fwrite(&limb, sizeof(limb), 1, file);
+		}
+	}
+
+	// named by a hash of the exact center, so the same center at the same precision reuses its file
+	std::string fileName(const BigFixed& cx, const BigFixed& cy) {
+		uint64_t hash = 14695981039346656037ULL;
+		for (const BigFixed* number : { &cx, &cy }) {
+			hash = (hash ^ (number->isNegative() ? 1 : 0)) * 1099511628211ULL;
+			for (int l = 0; l <= number->fractionLimbs(); l++)
+				hash = (hash ^ number->limb(l)) * 1099511628211ULL;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.orbit", (unsigned long long)hash);
+		return name;
+	}
+
+	BigFixed readNumber(const unsigned char* at, int limbs) {
+		std::vector<uint32_t> words(limbs + 2);
+		memcpy(words.data(), at, numberBytes(limbs));
+		return BigFixed::fromLimbs(words.data() + 1, limbs, words[0] != 0);
+	}
+}
+
+OrbitCache::OrbitCache(const std::string& directory) : directory(directory) {
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+	std::ifstream index(directory + "/index.txt");
+	std::string line;
+	while (std::getline(index, line)) {
+		std::istringstream fields(line);
+		Entry entry;
+		std::string cx, cy;
+		if (fields >> entry.file >> entry.limbs >> cx >> cy && entry.limbs > 0
+			&& BigFixed::parse(cx, entry.limbs, entry.cx) && BigFixed::parse(cy, entry.limbs, entry.cy))
+			entries.push_back(entry);
+	}
+}
+
+bool OrbitCache::load(const Entry& entry, ReferenceOrbit& orbit) const {
+	MappedFile file(directory + "/" + entry.file);
+	Header header;
+	if (file.size() < sizeof(Header))
+		return false;
+	memcpy(&header, file.data(), sizeof(header));
+	int limbs = (int)header.limbs;
+	if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || limbs != entry.limbs
+		|| file.size() < orbitOffset(limbs) + (size_t)header.length * sizeof(CompactOrbit::Correction)
+			+ (size_t)header.waypoints * WAYPOINT_BYTES || header.length == 0)
+		return false;
+
+	const unsigned char* numbers = file.data() + sizeof(Header);
+	orbit.cx = readNumber(numbers, limbs);
+	orbit.cy = readNumber(numbers + numberBytes(limbs), limbs);
+	orbit.zx = readNumber(numbers + 2 * numberBytes(limbs), limbs);
+	orbit.zy = readNumber(numbers + 3 * numberBytes(limbs), limbs);
+	orbit.escaped = header.escaped != 0;
+	std::vector<CompactOrbit::Correction> steps(header.length);
+	std::vector<CompactOrbit::Waypoint> waypoints;
+	waypoints.reserve(header.waypoints);
+	const unsigned char* at = file.data() + orbitOffset(limbs);
+	for (uint32_t n = 0; n < header.length; n++) {
+		memcpy(&steps[n], at, sizeof(CompactOrbit::Correction));
+		at += sizeof(CompactOrbit::Correction);
+		if (steps[n].r != CompactOrbit::WAYPOINT) {
+			// readers start from the first step of each block, which is always stored whole
+			if (n % CompactOrbit::BLOCK == 0)
+				return false;
+			continue;
+		}
+		// the size check above only holds for as many waypoints as the header counts
+		if (waypoints.size() == header.waypoints)
+			return false;
+		CompactOrbit::Waypoint waypoint = { (int)n, 0.0, 0.0 };
+		memcpy(&waypoint.zr, at, sizeof(double));
+		memcpy(&waypoint.zi, at + sizeof(double), sizeof(double));
+		at += WAYPOINT_BYTES;
+		waypoints.push_back(waypoint);
+	}
+	orbit.z = CompactOrbit(orbit.cx.toDouble(), orbit.cy.toDouble(), std::move(steps), std::move(waypoints));
+	return true;
+}
+
+bool OrbitCache::save(const Entry& entry, const ReferenceOrbit& orbit, int from) const {
+	// a new file is written whole; an extension appends the new steps before the header records them
+	std::string path = directory + "/" + entry.file;
+	FILE* file = fopen(path.c_str(), from == 0 ? "wb" : "r+b");
+	if (!file)
+		return false;
+	int limbs = entry.limbs;
+	const std::vector<CompactOrbit::Correction>& steps = orbit.z.stepCorrections();
+	const std::vector<CompactOrbit::Waypoint>& waypoints = orbit.z.stepWaypoints();
+	size_t waypoint = std::lower_bound(waypoints.begin(), waypoints.end(), from,
+		[](const CompactOrbit::Waypoint& point, int position) { return point.position < position; }) - waypoints.begin();
+	if (!seek(file, orbitOffset(limbs) + (uint64_t)from * sizeof(CompactOrbit::Correction) + (uint64_t)waypoint * WAYPOINT_BYTES)) {
+		fclose(file);
+		return false;
+	}
+	for (int n = from; n < orbit.length(); n++) {
+		fwrite(&steps[n], sizeof(CompactOrbit::Correction), 1, file);
+		if (steps[n].r == CompactOrbit::WAYPOINT) {
+			double value[2] = { waypoints[waypoint].zr, waypoints[waypoint].zi };
+			fwrite(value, sizeof(double), 2, file);
+			waypoint++;
+		}
+	}
+
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.limbs = (uint32_t)limbs;
+	header.length = (uint32_t)orbit.length();
+	header.escaped = orbit.escaped ? 1 : 0;
+	header.waypoints = (uint32_t)waypoints.size();
+	seek(file, 0);
+	fwrite(&header, sizeof(header), 1, file);
+	writeNumber(file, orbit.cx, limbs);
+	writeNumber(file, orbit.cy, limbs);
+	writeNumber(file, orbit.zx, limbs);
+	writeNumber(file, orbit.zy, limbs);
+	bool written = !ferror(file);
+	return fclose(file) == 0 && written;
+}
+
+ReferenceOrbit OrbitCache::referenceFor(const DeepView& view, int maxIterations) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	// the finer of the two coordinates sets the precision, so neither is truncated on disk
+	int limbs = std::max(view.centerX.fractionLimbs(), view.centerY.fractionLimbs());
+
+	// the cached orbit nearest the view's center, among those inside the view and precise enough for it
+	int best = -1;
+	FloatExp bestDistance;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& entry = entries[i];
+		if (entry.limbs < limbs)
+			continue;
+		FloatExp dx = fabs((entry.cx.withPrecision(limbs) - view.centerX).toFloatExp());
+		FloatExp dy = fabs((entry.cy.withPrecision(limbs) - view.centerY).toFloatExp());
+		if (dx > view.scaleX || dy > view.scaleY)
+			continue;
+		FloatExp distance = dx / view.scaleX + dy / view.scaleY;
+		if (best < 0 || distance < bestDistance) {
+			best = (int)i;
+			bestDistance = distance;
+		}
+	}
+
+	ReferenceOrbit orbit;
+	if (best >= 0 && !load(entries[best], orbit)) {
+		// deleted or from another version, drop it and compute the orbit again
+		entries.erase(entries.begin() + best);
+		best = -1;
+	}
+	if (best >= 0) {
+		if (orbit.covers(maxIterations)) {
+			hitCount++;
+			return orbit;
+		}
+		int from = orbit.length();
+		extendReferenceOrbit(orbit, maxIterations);
+		save(entries[best], orbit, from);
+		extensionCount++;
+		return orbit;
+	}
+
+	missCount++;
+	orbit = computeReferenceOrbit(view.centerX, view.centerY, maxIterations);
+	Entry entry = { fileName(view.centerX, view.centerY), limbs, view.centerX, view.centerY };
+	if (save(entry, orbit, 0)) {
+		entries.push_back(entry);
+		std::ofstream index(directory + "/index.txt", std::ios::app);
+		index << entry.file << " " << entry.limbs << " " << entry.cx.toExactString() << " " << entry.cy.toExactString() << std::endl;
+	}
+	return orbit;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "perturbation.h"
+
+// reference orbits kept on disk between runs, so re-rendering a deep location or zooming further into it
+// doesn't iterate the same high precision orbit again. each orbit is one file, read through a memory
+// mapping:
+//   header    "MBORBIT" magic, format version, fraction limbs, stored length, escaped flag, waypoint count
+//             (uint32 each)
+//   numbers   cx, cy, zx, zy: a uint32 sign then limbs + 1 uint32 magnitude limbs each
+//   orbit     each step as a CompactOrbit keeps it: two int8 corrections, followed by zr and zi as doubles
+//             when the step is a waypoint
+// the header and numbers have a fixed size, so extending an orbit appends to the end and rewrites the front.
+// index.txt lists every file with its exact center and precision.
+class OrbitCache {
+public:
+	explicit OrbitCache(const std::string& directory);
+
+	// a main reference for the view that covers maxIterations: a cached orbit whose center lies inside the
+	// view at the view's precision or better, extended and saved again if it is too short, or else a new
+	// orbit at the view's center
+	ReferenceOrbit referenceFor(const DeepView& view, int maxIterations);
+
+	size_t hits() const { return hitCount; }
+	size_t extensions() const { return extensionCount; }
+	size_t misses() const { return missCount; }
+
+private:
+	struct Entry {
+		std::string file;
+		int limbs;
+		BigFixed cx, cy;
+	};
+
+	bool load(const Entry& entry, ReferenceOrbit& orbit) const;
+	bool save(const Entry& entry, const ReferenceOrbit& orbit, int from) const;
+
+	std::string directory;
+	std::vector<Entry> entries;
+	std::mutex cacheMutex;
+
+	size_t hitCount = 0;
+	size_t extensionCount = 0;
+	size_t missCount = 0;
+};
@@ -0,0 +1,170 @@
+#include "orbitState.h"
+
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+
+#include <algorithm>
+
+void IterateUniforms::lookUp(unsigned int iterateProgram) {
+	if (iterateProgram == program)
+		return;
+	program = iterateProgram;
+	restart = glGetUniformLocation(program, "restart");
+	resolution = glGetUniformLocation(program, "resolution");
+	centerPosition = glGetUniformLocation(program, "centerPosition");
+	scale = glGetUniformLocation(program, "scale");
+	maxIterations = glGetUniformLocation(program, "maxIterations");
+	// a variant without one of these gets -1, which glUniform ignores
+	glUniform1i(glGetUniformLocation(program, "previousOrbit"), 0);
+	glUniform1i(glGetUniformLocation(program, "previousIterations"), 1);
+	glUniform1i(glGetUniformLocation(program, "previousDerivative"), 2);
+	glUniform1i(glGetUniformLocation(program, "orbitImage"), 0);
+	glUniform1i(glGetUniformLocation(program, "iterationImage"), 1);
+	glUniform1i(glGetUniformLocation(program, "derivativeImage"), 2);
+	glUniform1i(glGetUniformLocation(program, "distanceImage"), 3);
+}
+
+// pixels times iterations of the first pass, before anything is timed: a few hundred iterations of a full
+// HD frame, under a second even for a GPU slow at doubles
+static const double INITIAL_BUDGET = 1 << 30;
+
+IterationSlicer::IterationSlicer() : budget(INITIAL_BUDGET), liveBudget(INITIAL_BUDGET) {
+	glGenQueries(1, &query);
+}
+
+IterationSlicer::~IterationSlicer() {
+	glDeleteQueries(1, &query);
+}
+
+int IterationSlicer::nextCap(int reached, int maxIterations, int pixels) {
+	if (timing) {
+		timing = false;
+		// a pass the GPU hasn't finished keeps the old budget rather than stall on it
+		GLuint available = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		GLuint64 nanoseconds = 0;
+		if (available)
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		if (nanoseconds > 0) {
+			// escaped pixels cost nothing, so a pass can take far less than its budget. a fast one only lets
+			// the budget grow by so much, and a slow one only halves it, so one odd pass doesn't swing it
+			double fitted = timedWork * SLICE_MILLISECONDS / (nanoseconds * 1e-6);
+			budget = std::min(std::max(fitted, budget / 2), budget * 4);
+			if (timedRestart)
+				liveBudget = budget;
+		}
+	}
+	// with most orbits escaped the budget grows far past what a pass of every pixel could take, so a render
+	// that starts over goes back to the last budget timed with all of them running
+	if (reached == 0)
+		budget = std::min(budget, liveBudget);
+	timedRestart = reached == 0;
+	// orbits start at 1 iteration, and every pass goes at least 1 further
+	int from = std::max(reached, 1);
+	double iterations = std::max(budget / std::max(pixels, 1), 1.0);
+	int cap = (int)std::min((double)std::max(maxIterations, 1), from + iterations);
+	timedWork = (double)pixels * (cap - from);
+	return cap;
+}
+
+void IterationSlicer::begin() {
+	glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void IterationSlicer::end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	timing = true;
+}
+
+OrbitState::OrbitState(bool distance) : distance(distance) {
+	glGenFramebuffers(2, framebuffers);
+	glGenTextures(2, orbitTextures);
+	glGenTextures(2, iterationTextures);
+	if (distance) {
+		glGenTextures(2, derivativeTextures);
+		glGenTextures(2, distanceTextures);
+	}
+}
+
+OrbitState::~OrbitState() {
+	glDeleteFramebuffers(2, framebuffers);
+	glDeleteTextures(2, orbitTextures);
+	glDeleteTextures(2, iterationTextures);
+	if (distance) {
+		glDeleteTextures(2, derivativeTextures);
+		glDeleteTextures(2, distanceTextures);
+	}
+}
+
+static void allocateTexture(unsigned int texture, GLenum internalFormat, GLenum format, int width, int height, GLenum type = GL_UNSIGNED_INT) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	// integer textures can't be filtered
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void OrbitState::allocate(int w, int h) {
+	width = w;
+	height = h;
+	reachedIterations = 0;
+	for (int i = 0; i < 2; i++) {
+		// z as two doubles split with packDouble2x32, so resuming is bit exact
+		allocateTexture(orbitTextures[i], GL_RGBA32UI, GL_RGBA_INTEGER, w, h);
+		allocateTexture(iterationTextures[i], GL_R32UI, GL_RED_INTEGER, w, h);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, orbitTextures[i], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, iterationTextures[i], 0);
+		if (distance) {
+			// dz/dc packed like z, and the estimate itself
+			allocateTexture(derivativeTextures[i], GL_RGBA32UI, GL_RGBA_INTEGER, w, h);
+			allocateTexture(distanceTextures[i], GL_R32F, GL_RED, w, h, GL_FLOAT);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, derivativeTextures[i], 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, distanceTextures[i], 0);
+		}
+		GLenum drawBuffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+		glDrawBuffers(distance ? 4 : 2, drawBuffers);
+	}
+}
+
+void OrbitState::update(unsigned int iterateProgram, int w, int h, double x, double y, double scale, int maxIterations) {
+	if (w != width || h != height)
+		allocate(w, h);
+
+	bool sameView = reachedIterations > 0 && x == viewX && y == viewY && scale == viewScale;
+	if (sameView && maxIterations <= reachedIterations)
+		return;
+
+	int next = 1 - current;
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[next]);
+	glViewport(0, 0, width, height);
+	glUseProgram(iterateProgram);
+	uniforms.lookUp(iterateProgram);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, orbitTextures[current]);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, iterationTextures[current]);
+	if (distance) {
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, derivativeTextures[current]);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(uniforms.restart, sameView ? 0 : 1);
+	glUniform2d(uniforms.resolution, width, height);
+	glUniform2d(uniforms.centerPosition, x, y);
+	glUniform1d(uniforms.scale, scale);
+	int cap = slicer.nextCap(sameView ? reachedIterations : 0, maxIterations, width * height);
+	glUniform1i(uniforms.maxIterations, cap);
+	slicer.begin();
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	slicer.end();
+
+	current = next;
+	viewX = x;
+	viewY = y;
+	viewScale = scale;
+	reachedIterations = cap;
+}
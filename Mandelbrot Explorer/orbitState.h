@@ -0,0 +1,88 @@
+#pragma once
+
+// uniform locations of an iterate program, looked up again only when the program changes. the texture
+// and image units of its inputs are set along with them, as they never change
+struct IterateUniforms {
+	unsigned int program = 0;
+	int restart = -1, resolution = -1, centerPosition = -1, scale = -1, maxIterations = -1;
+
+	// program has to be in use
+	void lookUp(unsigned int iterateProgram);
+};
+
+// GPU time a pass of the iterate shader aims for, well inside any driver's watchdog and short enough for
+// the window to keep drawing
+static const double SLICE_MILLISECONDS = 25;
+
+// splits a long render into passes of a bounded number of iterations, one a frame, each resuming from the
+// stored z of the one before, so no single draw runs long enough for the driver to reset the GPU. every
+// pass is timed with a query that is read back at the next, a frame later so it never stalls, and the
+// iterations of a pass are steered towards SLICE_MILLISECONDS
+class IterationSlicer {
+public:
+	IterationSlicer();
+	~IterationSlicer();
+
+	IterationSlicer(const IterationSlicer&) = delete;
+	IterationSlicer& operator=(const IterationSlicer&) = delete;
+
+	// the iteration cap of the next pass over pixels, for a render that got to reached, 0 to start over
+	int nextCap(int reached, int maxIterations, int pixels);
+
+	// around the pass's draw or dispatch
+	void begin();
+	void end();
+
+private:
+	unsigned int query;
+	bool timing = false; // a pass whose time hasn't been read yet
+	double timedWork = 0; // that pass's pixels times its iterations
+	bool timedRestart = false; // that pass started every orbit over
+	double budget; // pixels times iterations a pass may take
+	double liveBudget; // the budget as of the last pass that started every orbit over
+};
+
+// per-pixel orbit state (z and the iteration count) for the current view, kept on the GPU between frames.
+// raising maxIterations continues each capped pixel from where it stopped instead of starting over from
+// z = c; pixels that already escaped do no work. only a change of view or window size starts again.
+// a render of many iterations takes a pass a frame until it gets to maxIterations.
+// with distance set it also keeps dz/dc, for the DISTANCE_ESTIMATE variant of the iteration pass
+class OrbitState {
+public:
+	explicit OrbitState(bool distance = false);
+	~OrbitState();
+
+	// runs the next iteration pass if the state doesn't already cover this view at this many iterations.
+	// leaves the state's framebuffer bound.
+	void update(unsigned int iterateProgram, int width, int height, double x, double y, double scale, int maxIterations);
+
+	// forgets the view, so the next update starts every orbit over
+	void reset() { reachedIterations = 0; }
+
+	// the cap the counts have got to, where orbits that haven't escaped stopped
+	int reached() const { return reachedIterations; }
+
+	// R32UI texture of iteration counts, which can run past maxIterations after it has been lowered
+	unsigned int iterationTexture() const { return iterationTextures[current]; }
+	// R32F texture of distance estimates in pixels, only for a state made with distance
+	unsigned int distanceTexture() const { return distanceTextures[current]; }
+
+private:
+	void allocate(int width, int height);
+
+	// two sets of targets, the pass reads the current set and writes the other
+	unsigned int framebuffers[2];
+	unsigned int orbitTextures[2];
+	unsigned int iterationTextures[2];
+	unsigned int derivativeTextures[2] = { 0, 0 };
+	unsigned int distanceTextures[2] = { 0, 0 };
+	bool distance;
+	int current = 0;
+
+	IterateUniforms uniforms;
+	IterationSlicer slicer;
+
+	int width = 0, height = 0;
+	double viewX = 0, viewY = 0, viewScale = 0;
+	int reachedIterations = 0; // 0 when the state doesn't hold a view
+};
@@ -0,0 +1,123 @@
+#include "orbitStream.h"
+
+#include <algorithm>
+
+// iterations computed between checks for a new request, and between publishes
+static const int STEPS_PER_PUBLISH = 4096;
+
+OrbitBuffer::OrbitBuffer(const BigFixed& cx, const BigFixed& cy) : cx(cx), cy(cy), encoder(cx.toDouble(), cy.toDouble()) {}
+
+ReferenceOrbit OrbitBuffer::snapshot() const {
+	int count = published();
+	int stored = waypointCount.load(std::memory_order_acquire);
+	std::vector<CompactOrbit::Correction> steps(count);
+	for (int n = 0; n < count; n++)
+		steps[n] = corrections[n];
+	// waypoints past the length belong to a later publish
+	std::vector<CompactOrbit::Waypoint> points;
+	for (int w = 0; w < stored && waypoints[w].position < count; w++)
+		points.push_back(waypoints[w]);
+	CompactOrbit z(cx.toDouble(), cy.toDouble(), std::move(steps), std::move(points));
+	return { cx, cy, std::move(z), cx, cy, escaped() };
+}
+
+bool OrbitBuffer::append(double zr, double zi) {
+	if (corrections.full() || waypoints.full())
+		return false;
+	CompactOrbit::Correction correction = encoder.add(zr, zi);
+	corrections.append(correction);
+	if (correction.r == CompactOrbit::WAYPOINT)
+		waypoints.append({ corrections.size() - 1, zr, zi });
+	return true;
+}
+
+void OrbitBuffer::publish(bool escaped) {
+	if (escaped)
+		escapedFlag.store(true, std::memory_order_release);
+	waypointCount.store(waypoints.size(), std::memory_order_release);
+	length.store(corrections.size(), std::memory_order_release);
+}
+
+OrbitStream::OrbitStream() : worker(&OrbitStream::run, this) {}
+
+OrbitStream::~OrbitStream() {
+	{
+		std::lock_guard<std::mutex> lock(streamMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	worker.join();
+}
+
+std::shared_ptr<const OrbitBuffer> OrbitStream::request(const DeepView& view, int maxIterations) {
+	std::lock_guard<std::mutex> lock(streamMutex);
+	bool keep = false;
+	int limbs = std::max(view.centerX.fractionLimbs(), view.centerY.fractionLimbs());
+	if (current && current->cx.fractionLimbs() >= limbs && current->cy.fractionLimbs() >= limbs) {
+		// the same test as the disk cache: any reference inside the view will do
+		FloatExp dx = fabs((current->cx.withPrecision(limbs) - view.centerX).toFloatExp());
+		FloatExp dy = fabs((current->cy.withPrecision(limbs) - view.centerY).toFloatExp());
+		keep = dx <= view.scaleX && dy <= view.scaleY;
+	}
+	if (!keep) {
+		current = std::make_shared<OrbitBuffer>(view.centerX.withPrecision(limbs), view.centerY.withPrecision(limbs));
+		target = 0;
+	}
+	if (maxIterations > target) {
+		target = maxIterations;
+		wake.notify_all();
+	}
+	return current;
+}
+
+void OrbitStream::run() {
+	std::shared_ptr<OrbitBuffer> orbit;
+	BigFixed zx, zy;
+	int length = 0;
+	bool escaped = false;
+	while (true) {
+		int goal;
+		{
+			std::unique_lock<std::mutex> lock(streamMutex);
+			// sleep until there is an orbit that is short of its target
+			wake.wait(lock, [&]() {
+				if (stopping)
+					return true;
+				if (current != orbit)
+					return true;
+				return orbit && !escaped && length <= target;
+			});
+			if (stopping)
+				return;
+			if (current != orbit) {
+				// a new view, start over from Z_0 = 0 and Z_1 = C
+				orbit = current;
+				zx = orbit->cx;
+				zy = orbit->cy;
+				escaped = false;
+				orbit->append(0, 0);
+				length = 1;
+			}
+			goal = target;
+		}
+
+		// one chunk of the same iteration as computeReferenceOrbit, outside the lock
+		for (int step = 0; step < STEPS_PER_PUBLISH && length <= goal; step++) {
+			double dx = zx.toDouble(), dy = zy.toDouble();
+			// a full buffer ends the orbit just like an escape, it can't get any longer
+			if (!orbit->append(dx, dy)) {
+				escaped = true;
+				break;
+			}
+			length++;
+			if (dx * dx + dy * dy >= 4.0) {
+				escaped = true;
+				break;
+			}
+			BigFixed xy = zx * zy;
+			zx = zx * zx - zy * zy + orbit->cx;
+			zy = xy + xy + orbit->cy;
+		}
+		orbit->publish(escaped);
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "perturbation.h"
+
+// append-only store of a reference orbit's Z_n, shared by one writing thread and any number of readers
+// without locks. the orbit is kept the way CompactOrbit keeps it, in fixed size chunks that never move once
+// allocated. the writer publishes the new length only after the steps below it are in place, so readers
+// can use every step below published() while the orbit keeps growing.
+class OrbitBuffer {
+public:
+	OrbitBuffer(const BigFixed& cx, const BigFixed& cy);
+
+	const BigFixed cx, cy;
+
+	int published() const { return length.load(std::memory_order_acquire); }
+	// set before the final length is published, so a reader that sees it also sees the whole orbit
+	bool escaped() const { return escapedFlag.load(std::memory_order_acquire); }
+
+	// copies what has been published into an orbit the renderer can use. the copy can't be extended itself
+	ReferenceOrbit snapshot() const;
+
+	// writer side: append values, then publish them together
+	bool append(double zr, double zi);
+	void publish(bool escaped);
+
+private:
+	static const int CHUNK_BITS = 16;
+	static const int CHUNK_MASK = (1 << CHUNK_BITS) - 1;
+	static const int MAX_CHUNKS = 1 << 15; // 2^31 values
+
+	// values appended by the writer. readers only read indices it has published
+	template <typename T>
+	class Chunks {
+	public:
+		Chunks() {
+			for (std::atomic<Chunk*>& chunk : chunks)
+				chunk.store(nullptr, std::memory_order_relaxed);
+		}
+		~Chunks() {
+			for (std::atomic<Chunk*>& chunk : chunks)
+				delete chunk.load(std::memory_order_relaxed);
+		}
+
+		const T& operator[](int i) const { return chunks[i >> CHUNK_BITS].load(std::memory_order_relaxed)->values[i & CHUNK_MASK]; }
+
+		// writer only
+		int size() const { return count; }
+		bool full() const { return count == INT_MAX; }
+		void append(const T& value) {
+			int chunk = count >> CHUNK_BITS;
+			if (!chunks[chunk].load(std::memory_order_relaxed))
+				chunks[chunk].store(new Chunk, std::memory_order_relaxed);
+			chunks[chunk].load(std::memory_order_relaxed)->values[count & CHUNK_MASK] = value;
+			count++;
+		}
+
+	private:
+		struct Chunk {
+			T values[1 << CHUNK_BITS];
+		};
+		std::atomic<Chunk*> chunks[MAX_CHUNKS];
+		int count = 0;
+	};
+
+	Chunks<CompactOrbit::Correction> corrections;
+	Chunks<CompactOrbit::Waypoint> waypoints;
+	std::atomic<int> length{ 0 };
+	std::atomic<int> waypointCount{ 0 }; // stored before length, so there are always enough for it
+	std::atomic<bool> escapedFlag{ false };
+	CompactOrbit::Encoder encoder; // writer only
+};
+
+// computes the reference orbit of the live view on a background thread, so the render loop never waits
+// on high precision arithmetic. the orbit is published in chunks as it goes and extended whenever more
+// iterations are asked for. a new orbit is only started once the view no longer contains the current one
+// or needs more precision than it has.
+class OrbitStream {
+public:
+	OrbitStream();
+	~OrbitStream();
+
+	// the orbit for this view, to be computed up to maxIterations. returns straight away with whatever is
+	// published so far
+	std::shared_ptr<const OrbitBuffer> request(const DeepView& view, int maxIterations);
+
+private:
+	void run();
+
+	std::mutex streamMutex;
+	std::condition_variable wake;
+	std::shared_ptr<OrbitBuffer> current;
+	int target = 0;
+	bool stopping = false;
+	std::thread worker; // last, so everything it uses exists before it starts
+};
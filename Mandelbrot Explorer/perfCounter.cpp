@@ -0,0 +1,54 @@
+#include "perfCounter.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+CacheMissCounter::CacheMissCounter() {
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	// threads started later count into this one
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	counter = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+CacheMissCounter::~CacheMissCounter() {
+	if (counter >= 0)
+		close(counter);
+}
+
+void CacheMissCounter::start() {
+	if (counter < 0)
+		return;
+	ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+	ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+void CacheMissCounter::stop() {
+	if (counter >= 0)
+		ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+}
+
+long long CacheMissCounter::misses() const {
+	long long value = 0;
+	if (counter < 0 || read(counter, &value, sizeof(value)) != sizeof(value))
+		return -1;
+	return value;
+}
+#else
+// Windows only counts through a kernel driver or an ETW session with administrator rights
+CacheMissCounter::CacheMissCounter() {}
+CacheMissCounter::~CacheMissCounter() {}
+void CacheMissCounter::start() {}
+void CacheMissCounter::stop() {}
+long long CacheMissCounter::misses() const { return -1; }
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// last level cache misses from the CPU's hardware counters, of the thread that makes the counter and of
+// every thread it starts afterwards, such as the workers of a pool made after it. only Linux hands the
+// counters to an ordinary process, elsewhere the counter is never available
+class CacheMissCounter {
+public:
+	CacheMissCounter();
+	~CacheMissCounter();
+
+	CacheMissCounter(const CacheMissCounter&) = delete;
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	bool available() const { return counter >= 0; }
+
+	// counting from 0 again, and stopping, which leaves the count to read
+	void start();
+	void stop();
+	long long misses() const;
+
+private:
+	int counter = -1;
+};
@@ -0,0 +1,409 @@
+#include "perturbation.h"
+
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <utility>
+
+#include "bla.h"
+#include "fixed128.h"
+#include "kernel.h"
+#include "orbitCache.h"
+
+// Pauldelbrot's criterion, squared: |Z + delta|^2 < GLITCH_TOLERANCE * |Z|^2
+static const double GLITCH_TOLERANCE = 1e-6;
+// iteration count marking a pixel that needs another reference
+static const int GLITCHED = -1;
+// steps of a reference decoded from its CompactOrbit at a time, 1 MB as doubles
+static const int SEGMENT_STEPS = 1 << 16;
+// segments decoded at once. with rebasing, pixels of one reference can be at any step of it
+static const int DECODED_SEGMENTS = 32;
+
+ReferenceOrbit computeReferenceOrbit(const BigFixed& x, const BigFixed& y, int maxIterations) {
+	// both parts of the reference are iterated at the finer of their two precisions
+	int limbs = std::max(x.fractionLimbs(), y.fractionLimbs());
+	BigFixed cx = x.withPrecision(limbs), cy = y.withPrecision(limbs);
+	ReferenceOrbit orbit = { cx, cy, CompactOrbit(cx.toDouble(), cy.toDouble()), cx, cy, false };
+	orbit.z.push(0, 0);
+	extendReferenceOrbit(orbit, maxIterations);
+	return orbit;
+}
+
+void extendReferenceOrbit(ReferenceOrbit& orbit, int maxIterations) {
+	orbit.z.reserve(maxIterations + 1);
+	BigFixed& zx = orbit.zx;
+	BigFixed& zy = orbit.zy;
+	for (int n = orbit.length(); n <= maxIterations && !orbit.escaped; n++) {
+		double dx = zx.toDouble(), dy = zy.toDouble();
+		orbit.z.push(dx, dy);
+		if (dx * dx + dy * dy >= 4.0) {
+			orbit.escaped = true;
+			break;
+		}
+		BigFixed xy = zx * zy;
+		zx = zx * zx - zy * zy + orbit.cx;
+		zy = xy + xy + orbit.cy;
+	}
+}
+
+namespace {
+	struct PixelResult {
+		int iterations;
+		double glitchRatio; // |Z + delta|^2 / |Z|^2 when detected, lower is a better spot for a new reference
+		float distance;
+	};
+
+	// Z_n of a reference for the steps [first, end), decoded once and shared by every pixel iterating it
+	struct OrbitSegment {
+		int first = 0, end = 0;
+		std::vector<double> zr, zi;
+
+		void decode(const CompactOrbit& orbit, int from) {
+			first = from;
+			end = std::max(from, std::min(orbit.length(), from + SEGMENT_STEPS));
+			zr.resize(end - first);
+			zi.resize(end - first);
+			if (first == end)
+				return;
+			CompactOrbit::Reader z(orbit);
+			z.seek(first);
+			for (int n = first; n < end; n++) {
+				zr[n - first] = z.zr;
+				zi[n - first] = z.zi;
+				if (n + 1 < end)
+					z.next();
+			}
+		}
+	};
+
+	// where a pixel got to when it ran past the end of a segment
+	template <typename Real>
+	struct PixelState {
+		Real dr, di;
+		int n; // the pixel's iteration count
+		int m; // the step of the reference it is iterated against, n until it first rebases
+		Real ddr, ddi; // dz/dc times the pixel spacing, for distance estimates
+	};
+
+	// carries a pixel on from state until it is done, when it fills in result, or until it needs a step of
+	// the reference outside the segment, when it leaves state there and returns false.
+	// Z + delta and the glitch test only need doubles even when the delta itself doesn't fit in one.
+	// with rebase, a pixel whose Z + delta comes closer to 0 than delta itself, or that outlives the
+	// reference, starts over against the reference from Z_0 = 0 with delta = Z + delta (Zhuoran's rebasing).
+	// its delta then never grows past its orbit, so it never glitches, and the BLA runs that the reference's
+	// passes near 0 would cut short start afresh. without it those pixels count as glitched.
+	// with DISTANCE the derivative follows every step and skip, dz' = 2 (Z + delta) dz + 1 or A dz + B; c is
+	// the pixel's c in doubles and pixelSize the spacing the derivative is measured in
+	template <typename Real, bool DISTANCE>
+	bool iteratePixel(const OrbitSegment& segment, int length, const BlaTable<Real>* bla, bool rebase, Real dcr, Real dci, int maxIterations,
+		PixelState<Real>& state, PixelResult& result, double cr, double ci, Real pixelSize) {
+		const double* zr = segment.zr.data();
+		const double* zi = segment.zi.data();
+		Real dr = state.dr, di = state.di;
+		Real ddr = state.ddr, ddi = state.ddi;
+		int n = state.n, m = state.m;
+		while (n < maxIterations) {
+			if (m < segment.first || m >= segment.end) {
+				state = { dr, di, n, m, ddr, ddi };
+				return false;
+			}
+			double zrn = zr[m - segment.first], zin = zi[m - segment.first];
+			double x = zrn + toDouble(dr), y = zin + toDouble(di);
+			double magnitude = x * x + y * y;
+			if (magnitude >= 4.0) {
+				result = { n, 0, DISTANCE ? (float)escapeDistance(x, y, ddr, ddi, cr, ci) : 0.0f };
+				return true;
+			}
+			Real deltaNorm = dr * dr + di * di;
+			if (rebase) {
+				// a reference too short to go back to can't take the pixel any further
+				if (m + 1 >= length && m == 0) {
+					result = { GLITCHED, 1.0, 0.0f };
+					return true;
+				}
+				// at m = 0, Z is 0 and the pixel has just gone back to it
+				if (m > 0 && (m + 1 >= length || Real(magnitude) < deltaNorm)) {
+					dr = zrn + dr;
+					di = zin + di;
+					m = 0;
+					continue;
+				}
+			}
+			else {
+				double referenceMagnitude = zrn * zrn + zin * zin;
+				if (magnitude < GLITCH_TOLERANCE * referenceMagnitude) {
+					result = { GLITCHED, magnitude / referenceMagnitude, 0.0f };
+					return true;
+				}
+				if (m + 1 >= length) {
+					result = { GLITCHED, 1.0, 0.0f }; // the reference escaped before this pixel did
+					return true;
+				}
+			}
+
+			int steps;
+			const typename BlaTable<Real>::Step* run = bla ? bla->find(m, deltaNorm, std::min(maxIterations - n, length - 1 - m), steps) : nullptr;
+			if (run) {
+				Real t = run->ar * dr - run->ai * di + run->br * dcr - run->bi * dci;
+				di = run->ar * di + run->ai * dr + run->br * dci + run->bi * dcr;
+				dr = t;
+				if (DISTANCE) {
+					t = run->ar * ddr - run->ai * ddi + run->br * pixelSize;
+					ddi = run->ar * ddi + run->ai * ddr + run->bi * pixelSize;
+					ddr = t;
+				}
+				n += steps;
+				m += steps;
+				continue;
+			}
+
+			if (DISTANCE) {
+				Real xr = zrn + dr, xi = zin + di;
+				Real t = 2.0 * (xr * ddr - xi * ddi) + pixelSize;
+				ddi = 2.0 * (xr * ddi + xi * ddr);
+				ddr = t;
+			}
+			Real t = 2.0 * (zrn * dr - zin * di) + (dr * dr - di * di) + dcr;
+			di = 2.0 * (zrn * di + zin * dr) + 2.0 * dr * di + dci;
+			dr = t;
+			n++;
+			m++;
+		}
+		result = { maxIterations, 0, 0.0f };
+		return true;
+	}
+}
+
+// offset of a pixel center from the view center in fractal space, with the shader's orientation
+template <typename Real>
+static Real offsetX(const DeepView& view, int px) {
+	return ((px + 0.5) / view.width * 2.0 - 1.0) * fromFloatExp<Real>(view.scaleX);
+}
+
+template <typename Real>
+static Real offsetY(const DeepView& view, int py) {
+	return ((view.height - py - 0.5) / view.height * 2.0 - 1.0) * fromFloatExp<Real>(view.scaleY);
+}
+
+template <typename Real, bool DISTANCE>
+static PerturbationStats render(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations, const PerturbationOptions& options) {
+	bool bilinear = options.bilinear;
+	float* distances = options.distances;
+	Real pixelSize = fromFloatExp<Real>(2.0 * view.scaleY / (double)view.height);
+	int pixelCount = view.width * view.height;
+	std::vector<double> glitchRatio(pixelCount);
+	PerturbationStats stats = { 1, 0, 0, 0, 0 };
+
+	// pixels to render this round and the reference each uses. references sit at pixel centers, stored as
+	// their offset from the view center so deltaC stays small
+	std::vector<int> pending(pixelCount);
+	for (int i = 0; i < pixelCount; i++)
+		pending[i] = i;
+	std::vector<ReferenceOrbit> references;
+	if (options.reference)
+		references.push_back(*options.reference);
+	else if (options.cache)
+		references.push_back(options.cache->referenceFor(view, maxIterations));
+	else
+		references.push_back(computeReferenceOrbit(view.centerX, view.centerY, maxIterations));
+	// references can sit anywhere in the view, so deltaC is bounded by its diagonal
+	Real deltaCMax = fromFloatExp<Real>(2.0 * hypot(view.scaleX, view.scaleY));
+	std::vector<std::unique_ptr<BlaTable<Real>>> tables;
+	if (bilinear)
+		tables.emplace_back(new BlaTable<Real>(references[0], deltaCMax));
+	// a cached or given reference can sit anywhere in the view rather than at its center
+	int limbs = std::max(view.centerX.fractionLimbs(), view.centerY.fractionLimbs());
+	std::vector<Real> referenceX(1, fromFloatExp<Real>((references[0].cx.withPrecision(limbs) - view.centerX).toFloatExp()));
+	std::vector<Real> referenceY(1, fromFloatExp<Real>((references[0].cy.withPrecision(limbs) - view.centerY).toFloatExp()));
+	std::vector<int> pendingReference(pixelCount, 0);
+
+	while (!pending.empty() && stats.rounds < options.maxRounds) {
+		stats.rounds++;
+		// the references are decoded a segment at a time, and every pixel goes as far as its segment takes it.
+		// pixels that need a step outside it wait in states until a pass decodes the segment they are in
+		std::vector<PixelState<Real>> states(pending.size());
+		std::vector<int> active(pending.size());
+		for (size_t k = 0; k < pending.size(); k++) {
+			active[k] = (int)k;
+			int pixel = pending[k], r = pendingReference[k];
+			states[k] = { offsetX<Real>(view, pixel % view.width) - referenceX[r], offsetY<Real>(view, pixel / view.width) - referenceY[r],
+				1, 1, pixelSize, 0.0 };
+		}
+		// the references' c in doubles, for the steps distance estimates take past the escape
+		std::vector<double> referenceCr(references.size()), referenceCi(references.size());
+		if (DISTANCE) {
+			for (size_t r = 0; r < references.size(); r++) {
+				referenceCr[r] = references[r].cx.toDouble();
+				referenceCi[r] = references[r].cy.toDouble();
+			}
+		}
+		while (!active.empty()) {
+			// the segments the waiting pixels are in, as reference and segment index, the earliest first
+			std::vector<std::pair<int, int>> needed;
+			for (int k : active)
+				needed.push_back({ pendingReference[k], states[k].m / SEGMENT_STEPS });
+			std::sort(needed.begin(), needed.end());
+			needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+			if (needed.size() > (size_t)DECODED_SEGMENTS)
+				needed.resize(DECODED_SEGMENTS);
+			std::vector<OrbitSegment> segments(needed.size());
+			pool.parallelFor((int)needed.size(), [&](int s) {
+				segments[s].decode(references[needed[s].first].z, needed[s].second * SEGMENT_STEPS);
+			});
+
+			std::vector<char> waiting(active.size(), 0);
+			const int chunk = 256;
+			pool.parallelFor((int)(active.size() + chunk - 1) / chunk, [&](int c) {
+				size_t end = std::min(active.size(), (size_t)(c + 1) * chunk);
+				for (size_t a = (size_t)c * chunk; a < end; a++) {
+					int k = active[a];
+					int pixel = pending[k];
+					int r = pendingReference[k];
+					auto segment = std::lower_bound(needed.begin(), needed.end(), std::make_pair(r, states[k].m / SEGMENT_STEPS));
+					if (segment == needed.end() || *segment != std::make_pair(r, states[k].m / SEGMENT_STEPS)) {
+						waiting[a] = 1;
+						continue;
+					}
+					// deltaC relative to this pixel's reference, which sits at a pixel offset in the view
+					Real dcr = offsetX<Real>(view, pixel % view.width) - referenceX[r];
+					Real dci = offsetY<Real>(view, pixel / view.width) - referenceY[r];
+					double cr = 0, ci = 0;
+					if (DISTANCE) {
+						cr = referenceCr[r] + toDouble(dcr);
+						ci = referenceCi[r] + toDouble(dci);
+					}
+					PixelResult result;
+					if (!iteratePixel<Real, DISTANCE>(segments[segment - needed.begin()], references[r].length(), bilinear ? tables[r].get() : nullptr,
+						options.rebase, dcr, dci, maxIterations, states[k], result, cr, ci, pixelSize)) {
+						waiting[a] = 1;
+						continue;
+					}
+					iterations[pixel] = result.iterations;
+					glitchRatio[pixel] = result.glitchRatio;
+					if (DISTANCE)
+						distances[pixel] = result.distance;
+				}
+			});
+			size_t kept = 0;
+			for (size_t a = 0; a < active.size(); a++) {
+				if (waiting[a])
+					active[kept++] = active[a];
+			}
+			active.resize(kept);
+		}
+
+		// group what is still glitched into connected areas, including areas left over from earlier rounds
+		std::vector<int> glitched;
+		for (int pixel = 0; pixel < pixelCount; pixel++) {
+			if (iterations[pixel] == GLITCHED)
+				glitched.push_back(pixel);
+		}
+		if (glitched.empty() || stats.rounds == options.maxRounds)
+			break;
+
+		std::vector<int> area(pixelCount, -1);
+		std::vector<std::vector<int>> areas;
+		for (int seed : glitched) {
+			if (area[seed] >= 0)
+				continue;
+			int id = (int)areas.size();
+			areas.emplace_back();
+			std::vector<int> stack(1, seed);
+			area[seed] = id;
+			while (!stack.empty()) {
+				int pixel = stack.back();
+				stack.pop_back();
+				areas[id].push_back(pixel);
+				int px = pixel % view.width, py = pixel / view.width;
+				int neighbours[4] = { px > 0 ? pixel - 1 : -1, px + 1 < view.width ? pixel + 1 : -1,
+					py > 0 ? pixel - view.width : -1, py + 1 < view.height ? pixel + view.width : -1 };
+				for (int neighbour : neighbours) {
+					if (neighbour >= 0 && area[neighbour] < 0 && iterations[neighbour] == GLITCHED) {
+						area[neighbour] = id;
+						stack.push_back(neighbour);
+					}
+				}
+			}
+		}
+
+		// the largest areas get a new reference each this round, as many as there are threads to compute them.
+		// the orbits are independent, so they are computed in parallel
+		std::sort(areas.begin(), areas.end(), [](const std::vector<int>& a, const std::vector<int>& b) { return a.size() > b.size(); });
+		size_t newCount = std::min(areas.size(), (size_t)std::max(1u, pool.size()));
+		std::vector<int> seeds(newCount);
+		for (size_t a = 0; a < newCount; a++) {
+			// the most glitched pixel is closest to the feature the old reference couldn't follow
+			seeds[a] = *std::min_element(areas[a].begin(), areas[a].end(), [&](int p, int q) { return glitchRatio[p] < glitchRatio[q]; });
+		}
+
+		size_t firstNew = references.size();
+		references.resize(firstNew + newCount);
+		tables.resize(firstNew + newCount);
+		referenceX.resize(firstNew + newCount);
+		referenceY.resize(firstNew + newCount);
+		pool.parallelFor((int)newCount, [&](int a) {
+			Real ox = offsetX<Real>(view, seeds[a] % view.width), oy = offsetY<Real>(view, seeds[a] / view.width);
+			references[firstNew + a] = computeReferenceOrbit(view.centerX + BigFixed::fromFloatExp(ox, limbs),
+				view.centerY + BigFixed::fromFloatExp(oy, limbs), maxIterations);
+			if (bilinear)
+				tables[firstNew + a].reset(new BlaTable<Real>(references[firstNew + a], deltaCMax));
+			referenceX[firstNew + a] = ox;
+			referenceY[firstNew + a] = oy;
+		});
+		stats.references += (int)newCount;
+
+		// only the areas that got a reference are retried, the rest stay glitched for the next round
+		pending.clear();
+		pendingReference.clear();
+		for (size_t a = 0; a < newCount; a++) {
+			for (int pixel : areas[a]) {
+				pending.push_back(pixel);
+				pendingReference.push_back((int)(firstNew + a));
+			}
+		}
+	}
+
+	// anything still glitched after the last round is iterated directly if Fixed128 can resolve the view
+	// and this isn't a preview, otherwise it is shown as interior
+	std::vector<int> leftover;
+	for (int i = 0; i < pixelCount; i++) {
+		if (iterations[i] == GLITCHED)
+			leftover.push_back(i);
+	}
+	if (!leftover.empty() && options.maxRounds > 1 && fixed128Resolves(view)) {
+		Fixed128 centerX = Fixed128::fromBigFixed(view.centerX), centerY = Fixed128::fromBigFixed(view.centerY);
+		pool.parallelFor((int)leftover.size(), [&](int k) {
+			int pixel = leftover[k];
+			Fixed128 cx = centerX + Fixed128::fromDouble(toDouble(offsetX<Real>(view, pixel % view.width)));
+			Fixed128 cy = centerY + Fixed128::fromDouble(toDouble(offsetY<Real>(view, pixel / view.width)));
+			if (DISTANCE)
+				iterations[pixel] = fixed128Distance(cx, cy, maxIterations, toDouble(pixelSize), distances[pixel]);
+			else
+				iterations[pixel] = fixed128Iterations(cx, cy, maxIterations);
+		});
+		leftover.clear();
+	}
+	for (int pixel : leftover) {
+		iterations[pixel] = maxIterations;
+		if (DISTANCE)
+			distances[pixel] = 0.0f;
+	}
+	stats.glitchedPixels = (long long)leftover.size();
+	for (const ReferenceOrbit& reference : references) {
+		stats.orbitSteps += reference.length();
+		stats.orbitBytes += (long long)reference.z.bytes();
+	}
+	return stats;
+}
+
+PerturbationStats renderPerturbation(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations,
+	const PerturbationOptions& options) {
+	// FloatExp arithmetic costs several times more than double, so only views that need it pay for it
+	bool distance = options.distances != nullptr;
+	if (view.scaleY < FloatExp(FLOATEXP_SCALE)) {
+		return distance ? render<FloatExp, true>(view, maxIterations, pool, iterations, options)
+			: render<FloatExp, false>(view, maxIterations, pool, iterations, options);
+	}
+	return distance ? render<double, true>(view, maxIterations, pool, iterations, options)
+		: render<double, false>(view, maxIterations, pool, iterations, options);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "bigFixed.h"
+#include "compactOrbit.h"
+#include "threadPool.h"
+
+// perturbation rendering for zooms past double precision. one orbit Z is iterated in high precision and
+// every pixel only iterates its small difference from it in doubles:
+//   delta' = 2 Z delta + delta^2 + deltaC
+// a pixel whose Z + delta comes closer to 0 than delta, or that outlives the reference, is rebased: it
+// carries on against the reference from its start with delta = Z + delta. without rebasing, pixels whose
+// delta loses precision against Z (Pauldelbrot's |Z + delta| < 1e-3 |Z|) or that outlive the reference are
+// glitched; they get re-rendered against new references placed inside the glitched areas.
+
+// views smaller than this lose pixels to double rounding in the direct kernels
+static const double PERTURBATION_SCALE = 1e-12;
+// views smaller than this have deltas near the bottom of double's exponent range, so they are iterated as
+// FloatExp. the margin leaves room for the squares and products of a step
+static const double FLOATEXP_SCALE = 1e-290;
+
+struct ReferenceOrbit {
+	BigFixed cx, cy;
+	// Z_n rounded to doubles, index n matching the kernels' iteration count (Z_0 = 0, Z_1 = C)
+	CompactOrbit z;
+	// Z_length in full precision, where extending the orbit carries on from
+	BigFixed zx, zy;
+	bool escaped;
+
+	// number of Z_n that are usable, the orbit ends early if the reference escapes
+	int length() const { return z.length(); }
+	// whether the orbit covers maxIterations, or can't get any longer
+	bool covers(int maxIterations) const { return escaped || length() > maxIterations; }
+};
+
+ReferenceOrbit computeReferenceOrbit(const BigFixed& cx, const BigFixed& cy, int maxIterations);
+// continues an orbit from where it stopped, up to maxIterations
+void extendReferenceOrbit(ReferenceOrbit& orbit, int maxIterations);
+
+// a rectangular view: center in high precision, half the width and height in fractal space
+struct DeepView {
+	BigFixed centerX, centerY;
+	FloatExp scaleX, scaleY;
+	int width, height;
+};
+
+class OrbitCache;
+
+struct PerturbationStats {
+	int references;
+	int rounds;
+	long long glitchedPixels; // left glitched after the last round, and too deep to iterate directly
+	long long orbitSteps, orbitBytes; // over every reference, what 16 bytes a step would take and what they hold
+};
+
+struct PerturbationOptions {
+	// skip iterations with a BlaTable per reference wherever the linearisation holds
+	bool bilinear = true;
+	// rebase pixels onto the start of their reference instead of counting them as glitched. the table's
+	// runs are cut short wherever the reference passes near 0, and a rebased pixel picks them up again
+	// from the start, so a deep minibrot costs a few runs per period rather than every step
+	bool rebase = true;
+	// where the main reference comes from when it holds one inside the view
+	OrbitCache* cache = nullptr;
+	// a main reference to use as it is, such as a snapshot of an orbit still being computed. pixels that
+	// outlive it count as glitched
+	const ReferenceOrbit* reference = nullptr;
+	// passes over the image, the first against the main reference and each later one with new references
+	// for what is still glitched. after the last, glitched pixels are iterated directly if Fixed128 resolves
+	// the view, unless this is 1: a single pass is a preview and leaves them as interior
+	int maxRounds = 32;
+	// if given, gets a distance estimate per pixel in pixels, 0 where the pixel didn't escape. carrying the
+	// derivative costs extra work, so renders without it use a variant of the kernel that leaves it out
+	float* distances = nullptr;
+};
+
+// writes an iteration count per pixel, top row first, counted the way the other kernels count
+PerturbationStats renderPerturbation(const DeepView& view, int maxIterations, ThreadPool& pool, int* iterations,
+	const PerturbationOptions& options = PerturbationOptions());
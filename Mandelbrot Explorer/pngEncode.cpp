@@ -0,0 +1,13 @@
+#include "pngEncode.h"
+
+#include "stb_image_write.h"
+
+static void appendToString(void* context, void* data, int size) {
+	static_cast<std::string*>(context)->append(static_cast<const char*>(data), size);
+}
+
+std::string encodePng(const unsigned char* rgb, int width, int height) {
+	std::string png;
+	stbi_write_png_to_func(appendToString, &png, width, height, 3, rgb, width * 3);
+	return png;
+}
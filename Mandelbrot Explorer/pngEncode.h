@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// encodes a tightly packed, top-down RGB buffer as a PNG held in memory.
+// relies on stb's flip-on-write being off, which is the default; only saveImage() turns it on.
+std::string encodePng(const unsigned char* rgb, int width, int height);
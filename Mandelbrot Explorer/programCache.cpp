@@ -0,0 +1,300 @@
+#include "programCache.h"
+
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "shaderSources.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const char MAGIC[8] = "MBSHADR";
+
+namespace {
+	struct Header {
+		char magic[8];
+		uint32_t format;
+		uint32_t length;
+	};
+
+	uint64_t hashText(uint64_t hash, const std::string& text) {
+		// FNV-1a, with the terminator so the boundaries between texts count too
+		for (size_t i = 0; i <= text.size(); i++)
+			hash = (hash ^ (unsigned char)text.c_str()[i]) * 1099511628211ULL;
+		return hash;
+	}
+
+	std::string glString(GLenum name) {
+		const GLubyte* text = glGetString(name);
+		return text ? (const char*)text : "";
+	}
+
+	unsigned int compileShader(GLenum type, const std::string& source) {
+		unsigned int id = glCreateShader(type);
+		const char* codePointer = source.c_str();
+		glShaderSource(id, 1, &codePointer, NULL);
+		glCompileShader(id);
+		return id;
+	}
+
+	// prints the log of a shader that failed, true if it compiled
+	bool checkShader(unsigned int id, const std::string& name) {
+		int success, length;
+		glGetShaderiv(id, GL_COMPILE_STATUS, &success);
+		if (success)
+			return true;
+		glGetShaderiv(id, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> infoLog(length + 1);
+		glGetShaderInfoLog(id, length + 1, NULL, infoLog.data());
+		std::cout << name << ": " << infoLog.data() << std::endl;
+		return false;
+	}
+
+	bool checkProgram(unsigned int id, const std::string& name) {
+		int success, length;
+		glGetProgramiv(id, GL_LINK_STATUS, &success);
+		if (success)
+			return true;
+		glGetProgramiv(id, GL_INFO_LOG_LENGTH, &length);
+		std::vector<char> infoLog(length + 1);
+		glGetProgramInfoLog(id, length + 1, NULL, infoLog.data());
+		std::cout << name << " link: " << infoLog.data() << std::endl;
+		return false;
+	}
+}
+
+ProgramCache::ProgramCache(GLFWwindow* window, const std::string& directory) : directory(directory) {
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+	driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+	if (GLEW_ARB_get_program_binary) {
+		// a driver may support the calls and still have no format to save in
+		int formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		binaries = formats > 0;
+	}
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	context = glfwCreateWindow(1, 1, "", NULL, window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+	if (context)
+		worker = std::thread(&ProgramCache::work, this);
+	else
+		std::cout << "No context to compile shaders in the background, they are compiled as they are needed" << std::endl;
+}
+
+ProgramCache::~ProgramCache() {
+	if (!context)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		stopping = true;
+	}
+	queued.notify_all();
+	worker.join();
+	glfwDestroyWindow(context);
+}
+
+ProgramCache::Program& ProgramCache::find(const char* vertex, const char* fragment, const std::string& defines) {
+	std::string key = std::string(vertex) + "\n" + fragment + "\n" + defines;
+	Program& program = programs[key];
+	if (program.vertex.empty()) {
+		program.vertex = vertex;
+		program.fragment = fragment;
+		program.defines = defines;
+	}
+	return program;
+}
+
+unsigned int ProgramCache::request(const char* vertex, const char* fragment, const std::string& defines) {
+	if (!context)
+		return wait(vertex, fragment, defines);
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	Program& program = find(vertex, fragment, defines);
+	if (program.ready)
+		return program.id;
+	if (!program.queued) {
+		program.queued = true;
+		queue.push_back(&program);
+		queued.notify_one();
+	}
+	return 0;
+}
+
+unsigned int ProgramCache::wait(const char* vertex, const char* fragment, const std::string& defines) {
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	Program& program = find(vertex, fragment, defines);
+	if (program.ready)
+		return program.id;
+	if (!context) {
+		// built right here in the window's context
+		Build build;
+		build.program = &program;
+		start(build);
+		finish(build);
+		program.id = build.id;
+		program.ready = true;
+		return program.id;
+	}
+	// ahead of whatever was prefetched
+	if (!program.queued) {
+		program.queued = true;
+		queue.push_front(&program);
+		queued.notify_one();
+	}
+	else {
+		auto at = std::find(queue.begin(), queue.end(), &program);
+		if (at != queue.end()) {
+			queue.erase(at);
+			queue.push_front(&program);
+		}
+	}
+	built.wait(lock, [&]() { return program.ready; });
+	return program.id;
+}
+
+void ProgramCache::start(Build& build) {
+	const Program& program = *build.program;
+	bool compute = program.vertex.empty();
+	std::string vertexSource = compute ? "" : embeddedShader(program.vertex.c_str());
+	std::string fragmentSource = embeddedShader(program.fragment.c_str());
+	if ((!compute && vertexSource.empty()) || fragmentSource.empty())
+		return;
+	size_t versionEnd = fragmentSource.find('\n');
+	if (!program.defines.empty() && versionEnd != std::string::npos)
+		fragmentSource.insert(versionEnd + 1, program.defines);
+
+	uint64_t hash = hashText(hashText(hashText(14695981039346656037ULL, driver), vertexSource), fragmentSource);
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+	build.path = directory + "/" + name;
+
+	build.id = glCreateProgram();
+	if (binaries && loadBinary(build.id, build.path)) {
+		build.loaded = true;
+		return;
+	}
+	// with ARB_parallel_shader_compile these return straight away, and the driver's threads do the work
+	// while the rest of the batch is submitted. finish() is the first call that waits for it
+	if (!compute) {
+		build.vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
+		glAttachShader(build.id, build.vertexShader);
+	}
+	build.fragmentShader = compileShader(compute ? GL_COMPUTE_SHADER : GL_FRAGMENT_SHADER, fragmentSource);
+	glAttachShader(build.id, build.fragmentShader);
+	if (binaries)
+		glProgramParameteri(build.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(build.id);
+}
+
+void ProgramCache::finish(Build& build) {
+	if (!build.id || build.loaded)
+		return;
+	const Program& program = *build.program;
+	bool compiled = !build.vertexShader || checkShader(build.vertexShader, program.vertex);
+	compiled = checkShader(build.fragmentShader, program.fragment) && compiled;
+	bool linked = compiled && checkProgram(build.id, program.fragment);
+
+	for (unsigned int shader : { build.vertexShader, build.fragmentShader }) {
+		if (!shader)
+			continue;
+		glDetachShader(build.id, shader);
+		glDeleteShader(shader);
+	}
+
+	if (!linked) {
+		// no program at all, so the caller falls back rather than drawing with a broken one
+		glDeleteProgram(build.id);
+		build.id = 0;
+	}
+	else if (binaries)
+		saveBinary(build.id, build.path);
+}
+
+bool ProgramCache::loadBinary(unsigned int id, const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	Header header;
+	if (!file.read((char*)&header, sizeof(header)) || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		return false;
+	// a truncated or corrupt file can claim any length, it has to fit in what is left of the file
+	std::streamoff start = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - start;
+	file.seekg(start);
+	if (header.length == 0 || (std::streamoff)header.length > remaining)
+		return false;
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return false;
+	glProgramBinary(id, header.format, binary.data(), (GLsizei)binary.size());
+	// a driver can still turn down a binary it made, and then the program is compiled from source
+	int success;
+	glGetProgramiv(id, GL_LINK_STATUS, &success);
+	return success != 0;
+}
+
+void ProgramCache::saveBinary(unsigned int id, const std::string& path) const {
+	int length = 0;
+	glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(id, length, &length, &format, binary.data());
+	Header header;
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.format = format;
+	header.length = (uint32_t)length;
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+}
+
+void ProgramCache::work() {
+	glfwMakeContextCurrent(context);
+	if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF); // as many as the driver likes
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	while (true) {
+		queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+		if (stopping)
+			break;
+		std::vector<Build> batch(queue.size());
+		for (Build& build : batch) {
+			build.program = queue.front();
+			queue.pop_front();
+		}
+		lock.unlock();
+
+		for (Build& build : batch)
+			start(build);
+		for (Build& build : batch)
+			finish(build);
+		// the window's context may use them as soon as they are ready
+		glFinish();
+
+		lock.lock();
+		for (Build& build : batch) {
+			build.program->id = build.id;
+			build.program->ready = true;
+		}
+		built.notify_all();
+	}
+	glfwMakeContextCurrent(NULL);
+}
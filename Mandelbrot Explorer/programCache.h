@@ -0,0 +1,70 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct GLFWwindow;
+
+// linked shader programs, built from the embedded shaders of shaderSources.h. a program is built on a
+// hidden context that shares objects with the window's, so asking for a new variant doesn't stall the
+// frame, and everything queued is compiled at once so drivers with ARB_parallel_shader_compile spread it
+// over their threads. linked programs are saved with glGetProgramBinary, one file per program:
+//   header    "MBSHADR" magic, binary format, binary length (uint32 each)
+//   binary    what the driver returned
+// named by a hash of the driver's vendor, renderer and version with both sources, so a driver update or
+// an edited shader misses the cache instead of loading a stale binary
+class ProgramCache {
+public:
+	// window's context must be current, it is the one the programs are used in
+	ProgramCache(GLFWwindow* window, const std::string& directory);
+	~ProgramCache();
+
+	// the program of the fragment shader with defines inserted after its #version line, or 0 while it is
+	// being built. the first request queues it
+	unsigned int request(const char* vertex, const char* fragment, const std::string& defines = "");
+	// the same, waiting for the program if it is not built yet
+	unsigned int wait(const char* vertex, const char* fragment, const std::string& defines = "");
+	// a compute program of one shader, which has to say which extensions it needs in defines
+	unsigned int requestCompute(const char* compute, const std::string& defines) { return request("", compute, defines); }
+	unsigned int waitCompute(const char* compute, const std::string& defines) { return wait("", compute, defines); }
+
+private:
+	struct Program {
+		std::string vertex, fragment, defines; // no vertex shader for a compute program, fragment is the compute shader
+		unsigned int id = 0;
+		bool queued = false;
+		bool ready = false;
+	};
+
+	struct Build {
+		Program* program;
+		unsigned int id = 0;
+		unsigned int vertexShader = 0, fragmentShader = 0;
+		std::string path;
+		bool loaded = false; // from a saved binary
+	};
+
+	Program& find(const char* vertex, const char* fragment, const std::string& defines);
+	void start(Build& build);
+	void finish(Build& build);
+	bool loadBinary(unsigned int id, const std::string& path);
+	void saveBinary(unsigned int id, const std::string& path) const;
+	void work();
+
+	std::string directory;
+	std::string driver; // GL vendor, renderer and version
+	bool binaries = false; // whether the driver can hand out and take back program binaries
+	GLFWwindow* context = nullptr; // the hidden one builds run on, null if it couldn't be made
+
+	std::map<std::string, Program> programs;
+	std::deque<Program*> queue;
+	std::mutex cacheMutex;
+	std::condition_variable built;
+	std::condition_variable queued;
+	bool stopping = false;
+	std::thread worker;
+};
@@ -0,0 +1,567 @@
+#include "renderer.h"
+
+#define GLEW_STATIC
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "kernel.h"
+#include "orbitState.h"
+#include "programCache.h"
+#include "shaderSources.h"
+#include "threadPool.h"
+#include "tileSchedule.h"
+
+const char* backendName(Backend backend) {
+	switch (backend) {
+	case Backend::GPU_COMPUTE: return "compute";
+	case Backend::CPU_SCALAR: return "cpu";
+	case Backend::CPU_SIMD: return "simd";
+	case Backend::HYBRID: return "hybrid";
+	default: return "gpu";
+	}
+}
+
+bool parseBackend(const std::string& text, Backend& out) {
+	for (int i = 0; i < BACKEND_COUNT; i++) {
+		if (text == backendName((Backend)i)) {
+			out = (Backend)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// what iterateShader.glsl needs to build as a compute shader, ahead of everything shaderDefines() inserts
+static const char* COMPUTE_DEFINES =
+	"#extension GL_ARB_compute_shader : require\n"
+	"#extension GL_ARB_shader_image_load_store : require\n"
+	"#define COMPUTE\n";
+
+// the iterate pass specialised for a variant. while a variant is still being built the plain pass stands
+// in for it: without the interior check it counts the same, only slower, and without distance estimates
+// boundary shading is just off for a few frames. distance is cleared when that happens
+static unsigned int iterateProgram(ProgramCache& programs, KernelVariant variant, bool& distance, bool compute) {
+	distance = distance && variant.formula.isMandelbrot();
+	// estimates are only carried in doubles
+	variant.singlePrecision = variant.singlePrecision && !distance;
+	std::string prefix = compute ? COMPUTE_DEFINES : "";
+	unsigned int program = compute ? programs.requestCompute(ITERATE_SHADER, prefix + shaderDefines(variant, distance))
+		: programs.request(VERTEX_SHADER, ITERATE_SHADER, shaderDefines(variant, distance));
+	if (program)
+		return program;
+	variant.interiorCheck = false;
+	distance = false;
+	return compute ? programs.waitCompute(ITERATE_SHADER, prefix + shaderDefines(variant))
+		: programs.wait(VERTEX_SHADER, ITERATE_SHADER, shaderDefines(variant));
+}
+
+static void allocateTexture(unsigned int texture, GLenum internalFormat, GLenum format, GLenum type, int width, int height) {
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+// a GPU backend's name, and how far it has got through a render that takes more than one pass
+static std::string slicedStatus(const char* name, int reached, int target) {
+	if (reached >= target)
+		return name;
+	return std::string(name) + ", " + std::to_string(reached) + " of " + std::to_string(target) + " iterations";
+}
+
+namespace {
+	// the iterate pass into OrbitState's framebuffers, one state with distance estimates and one without
+	class FragmentRenderer : public Renderer {
+	public:
+		explicit FragmentRenderer(ProgramCache& programs) : programs(programs), distanceState(true) {}
+
+		Backend backend() const override { return Backend::GPU_FRAGMENT; }
+
+		void render(const FrameView& view, const KernelVariant& variant, bool& distance) override {
+			unsigned int program = iterateProgram(programs, variant, distance, false);
+			current = distance ? &distanceState : &plainState;
+			current->update(program, view.width, view.height, view.centerX, view.centerY, view.scale, view.maxIterations);
+			target = view.maxIterations;
+		}
+
+		void reset() override {
+			plainState.reset();
+			distanceState.reset();
+		}
+
+		unsigned int iterationTexture() const override { return current->iterationTexture(); }
+		unsigned int distanceTexture() const override { return current == &distanceState ? distanceState.distanceTexture() : 0; }
+		int reachedIterations() const override { return current->reached(); }
+
+		std::string status() const override { return slicedStatus("gpu", current->reached(), target); }
+
+	private:
+		ProgramCache& programs;
+		OrbitState plainState;
+		OrbitState distanceState;
+		OrbitState* current = &plainState;
+		int target = 0;
+	};
+
+	// the iterate pass as a compute shader, updating one set of textures in place through images
+	class ComputeRenderer : public Renderer {
+	public:
+		explicit ComputeRenderer(ProgramCache& programs) : programs(programs) {
+			glGenTextures(4, textures);
+		}
+
+		~ComputeRenderer() {
+			glDeleteTextures(4, textures);
+		}
+
+		Backend backend() const override { return Backend::GPU_COMPUTE; }
+
+		void render(const FrameView& view, const KernelVariant& variant, bool& distance) override {
+			unsigned int program = iterateProgram(programs, variant, distance, true);
+			if (view.width != width || view.height != height) {
+				width = view.width;
+				height = view.height;
+				reached = 0;
+				// as OrbitState lays them out
+				allocateTexture(textures[ORBIT], GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, width, height);
+				allocateTexture(textures[ITERATIONS], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, width, height);
+				allocateTexture(textures[DERIVATIVE], GL_RGBA32UI, GL_RGBA_INTEGER, GL_UNSIGNED_INT, width, height);
+				allocateTexture(textures[DISTANCE], GL_R32F, GL_RED, GL_FLOAT, width, height);
+			}
+			// dz/dc isn't kept by the plain variant, so switching to estimates starts over
+			bool sameView = reached > 0 && view.centerX == viewX && view.centerY == viewY && view.scale == viewScale
+				&& distance == distanceState;
+			target = view.maxIterations;
+			if (sameView && view.maxIterations <= reached)
+				return;
+
+			int cap = slicer.nextCap(sameView ? reached : 0, view.maxIterations, width * height);
+			glUseProgram(program);
+			uniforms.lookUp(program);
+			glBindImageTexture(0, textures[ORBIT], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32UI);
+			glBindImageTexture(1, textures[ITERATIONS], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+			if (distance) {
+				glBindImageTexture(2, textures[DERIVATIVE], 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32UI);
+				glBindImageTexture(3, textures[DISTANCE], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			}
+			glUniform1i(uniforms.restart, sameView ? 0 : 1);
+			glUniform2d(uniforms.resolution, width, height);
+			glUniform2d(uniforms.centerPosition, view.centerX, view.centerY);
+			glUniform1d(uniforms.scale, view.scale);
+			glUniform1i(uniforms.maxIterations, cap);
+			// the shader's groups are 8 x 8
+			slicer.begin();
+			glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+			slicer.end();
+			// the color pass samples what the images wrote, and the next dispatch reads it back
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+			viewX = view.centerX;
+			viewY = view.centerY;
+			viewScale = view.scale;
+			reached = cap;
+			distanceState = distance;
+		}
+
+		void reset() override { reached = 0; }
+
+		unsigned int iterationTexture() const override { return textures[ITERATIONS]; }
+		unsigned int distanceTexture() const override { return distanceState ? textures[DISTANCE] : 0; }
+		int reachedIterations() const override { return reached; }
+
+		std::string status() const override { return slicedStatus("compute", reached, target); }
+
+	private:
+		enum { ORBIT, ITERATIONS, DERIVATIVE, DISTANCE };
+
+		ProgramCache& programs;
+		unsigned int textures[4];
+		IterateUniforms uniforms;
+		IterationSlicer slicer;
+		int width = 0, height = 0;
+		double viewX = 0, viewY = 0, viewScale = 0;
+		int reached = 0, target = 0;
+		bool distanceState = false;
+	};
+
+	// the CPU kernels on a thread pool, uploaded into textures. they count from z = c every time the view
+	// or maxIterations changes
+	class CpuRenderer : public Renderer {
+	public:
+		CpuRenderer(ThreadPool& pool, bool lanes) : pool(pool), lanes(lanes) {
+			glGenTextures(2, textures);
+		}
+
+		~CpuRenderer() {
+			glDeleteTextures(2, textures);
+		}
+
+		Backend backend() const override { return lanes ? Backend::CPU_SIMD : Backend::CPU_SCALAR; }
+
+		void render(const FrameView& view, const KernelVariant& variant, bool& distance) override {
+			distance = distance && variant.formula.isMandelbrot();
+			KernelVariant kernel = variant;
+			kernel.singlePrecision = kernel.singlePrecision && !distance;
+			std::string key = shaderDefines(kernel, distance);
+			if (rendered && view.centerX == last.centerX && view.centerY == last.centerY && view.scale == last.scale
+				&& view.width == last.width && view.height == last.height && view.maxIterations == last.maxIterations && key == lastKernel)
+				return;
+
+			TileGrid grid = { view.width, view.height, CPU_TILE };
+			counts.allocate(grid, pool);
+			if (view.width != last.width || view.height != last.height) {
+				rows.resize((size_t)view.width * view.height);
+				distances.resize(rows.size());
+				allocateTexture(textures[0], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, view.width, view.height);
+				allocateTexture(textures[1], GL_R32F, GL_RED, GL_FLOAT, view.width, view.height);
+			}
+			std::vector<double> cr(view.width);
+			for (int px = 0; px < view.width; px++)
+				cr[px] = pixelReal(view.centerX, view.scale, px, view.width);
+			double pixelSize = 2.0 * view.scale / view.height;
+
+			if (distance) {
+				// only the Mandelbrot kernel carries dz/dc, a pixel at a time
+				pool.parallelFor(view.height, [&](int py) {
+					double ci = pixelImaginary(view.centerY, view.scale, py, view.height);
+					size_t row = (size_t)(view.height - 1 - py) * view.width;
+					for (int px = 0; px < view.width; px++)
+						counts.at(px, py) = mandelbrotDistance(cr[px], ci, view.maxIterations, pixelSize, distances[row + px]);
+				});
+			}
+			else if (lanes) {
+				withKernel<LaneKernel>(kernel, [&](const auto& k) { renderTiles(k, view, grid, cr); });
+			}
+			else {
+				withKernel(kernel, [&](const auto& k) { renderTiles(k, view, grid, cr); });
+			}
+
+			// rows go bottom up in the texture, as the shader's own pass writes them. the counts are only laid out
+			// row by row here, on the way to the GPU
+			counts.copyToRows(rows.data(), pool);
+			glBindTexture(GL_TEXTURE_2D, textures[0]);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, view.width, view.height, GL_RED_INTEGER, GL_UNSIGNED_INT, rows.data());
+			if (distance) {
+				glBindTexture(GL_TEXTURE_2D, textures[1]);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, view.width, view.height, GL_RED, GL_FLOAT, distances.data());
+			}
+			last = view;
+			lastKernel = key;
+			rendered = true;
+			hasDistances = distance;
+		}
+
+		void reset() override { rendered = false; }
+
+		unsigned int iterationTexture() const override { return textures[0]; }
+		unsigned int distanceTexture() const override { return hasDistances ? textures[1] : 0; }
+		int reachedIterations() const override { return last.maxIterations; }
+
+	private:
+		// the tiles predicted to be slowest first, so no thread is left with a long one at the end, each on the
+		// node its part of the counts lives on
+		template <typename Kernel>
+		void renderTiles(const Kernel& kernel, const FrameView& view, const TileGrid& grid, const std::vector<double>& cr) {
+			std::vector<int> order = costs.longestFirst(view, grid, pool,
+				[&](int tile) { return estimateTileCost(kernel, view, grid.rect(tile)); });
+			pool.parallelForEach(order, [&](int tile) { return tileNode(grid, tile, pool.nodeCount()); }, [&](int tile) {
+				costs.record(tile, renderTile(kernel, view, tile, cr.data(), counts));
+			});
+		}
+
+		ThreadPool& pool;
+		bool lanes;
+		unsigned int textures[2];
+		// kept between frames so a render allocates nothing
+		CountBuffer counts;
+		std::vector<unsigned int> rows; // counts in the texture's layout, for the upload
+		std::vector<float> distances;
+		TileCostModel costs;
+		FrameView last = { 0, 0, 0, 0, 0, 0 };
+		std::string lastKernel;
+		bool rendered = false;
+		bool hasDistances = false;
+	};
+
+	// side of the hybrid renderer's tiles in pixels, enough of them that the split can be fine and few
+	// enough that a tile is still worth a draw call
+	static const int HYBRID_TILE = 64;
+
+	// splits the view into tiles between the fragment pass and LaneKernel, which work at the same time. the
+	// GPU's share is set from how many pixels a second each side managed on the previous frame, so that both
+	// finish together. the tiles are dealt out evenly over the view rather than in one block each, so both
+	// sides get a similar mix of cheap and expensive tiles and their speeds carry over to the next frame.
+	// it counts from z = c every time, as the CPU renderers do, and has no distance estimates
+	class HybridRenderer : public Renderer {
+	public:
+		HybridRenderer(ProgramCache& programs, ThreadPool& pool) : programs(programs), pool(pool) {
+			glGenFramebuffers(1, &framebuffer);
+			glGenTextures(1, &texture);
+			glGenQueries(1, &timer);
+		}
+
+		~HybridRenderer() {
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteTextures(1, &texture);
+			glDeleteQueries(1, &timer);
+		}
+
+		Backend backend() const override { return Backend::HYBRID; }
+
+		void render(const FrameView& view, const KernelVariant& variant, bool& distance) override {
+			distance = false;
+			std::string key = shaderDefines(variant);
+			if (rendered && view.centerX == last.centerX && view.centerY == last.centerY && view.scale == last.scale
+				&& view.width == last.width && view.height == last.height && view.maxIterations == last.maxIterations && key == lastKernel)
+				return;
+			measure();
+			unsigned int program = iterateProgram(programs, variant, distance, false);
+
+			int width = view.width, height = view.height;
+			TileGrid grid = { width, height, HYBRID_TILE };
+			counts.allocate(grid, pool);
+			if (width != last.width || height != last.height) {
+				allocateTexture(texture, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, width, height);
+				glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, texture, 0);
+				// the orbit isn't kept, only the count
+				GLenum drawBuffers[2] = { GL_NONE, GL_COLOR_ATTACHMENT1 };
+				glDrawBuffers(2, drawBuffers);
+			}
+			int tiles = grid.count();
+			gpuTiles.clear();
+			cpuTiles.clear();
+			for (int i = 0; i < tiles; i++) {
+				// tile i goes to the GPU whenever its running share passes another whole tile
+				bool gpu = (int)((i + 1) * gpuShare) > (int)(i * gpuShare);
+				(gpu ? gpuTiles : cpuTiles).push_back(i);
+			}
+			// each side keeps a tile, to keep measuring how fast it is
+			if (gpuTiles.empty() && tiles > 1) {
+				gpuTiles.push_back(cpuTiles.back());
+				cpuTiles.pop_back();
+			}
+			if (cpuTiles.empty() && tiles > 1) {
+				cpuTiles.push_back(gpuTiles.back());
+				gpuTiles.pop_back();
+			}
+
+			// the GPU's tiles first, it works through them while the CPU does its own
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glViewport(0, 0, width, height);
+			glUseProgram(program);
+			uniforms.lookUp(program);
+			glUniform1i(uniforms.restart, 1);
+			glUniform2d(uniforms.resolution, width, height);
+			glUniform2d(uniforms.centerPosition, view.centerX, view.centerY);
+			glUniform1d(uniforms.scale, view.scale);
+			glUniform1i(uniforms.maxIterations, std::max(view.maxIterations, 1));
+			glEnable(GL_SCISSOR_TEST);
+			glBeginQuery(GL_TIME_ELAPSED, timer);
+			for (int tile : gpuTiles) {
+				TileGrid::Rect r = grid.rect(tile);
+				// the texture's rows go bottom up
+				glScissor(r.x, height - r.y - r.height, r.width, r.height);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+			}
+			glEndQuery(GL_TIME_ELAPSED);
+			glDisable(GL_SCISSOR_TEST);
+			glFlush();
+
+			auto start = std::chrono::steady_clock::now();
+			std::vector<double> cr(width);
+			for (int px = 0; px < width; px++)
+				cr[px] = pixelReal(view.centerX, view.scale, px, width);
+			withKernel<LaneKernel>(variant, [&](const auto& kernel) {
+				// the CPU's tiles slowest first, as the CPU renderers take theirs. the GPU's get no estimate and so
+				// no cost, and one the split moves over to the CPU is estimated then
+				std::vector<char> onCpu(tiles, 0);
+				for (int tile : cpuTiles)
+					onCpu[tile] = 1;
+				std::vector<int> order;
+				for (int tile : costs.longestFirst(view, grid, pool,
+					[&](int tile) { return onCpu[tile] ? estimateTileCost(kernel, view, grid.rect(tile)) : -1.0; })) {
+					if (onCpu[tile])
+						order.push_back(tile);
+				}
+				pool.parallelForEach(order, [&](int tile) { return tileNode(grid, tile, pool.nodeCount()); }, [&](int tile) {
+					costs.record(tile, renderTile(kernel, view, tile, cr.data(), counts));
+				});
+			});
+			cpuSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// each tile's block is already bottom up, so it goes straight from its block
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, HYBRID_TILE);
+			for (int tile : cpuTiles) {
+				TileGrid::Rect r = grid.rect(tile);
+				glTexSubImage2D(GL_TEXTURE_2D, 0, r.x, height - r.y - r.height, r.width, r.height, GL_RED_INTEGER, GL_UNSIGNED_INT, counts.tile(tile));
+			}
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+			gpuPixels = cpuPixels = 0;
+			for (int tile : gpuTiles)
+				gpuPixels += area(grid.rect(tile));
+			for (int tile : cpuTiles)
+				cpuPixels += area(grid.rect(tile));
+			measuring = true;
+			last = view;
+			lastKernel = key;
+			rendered = true;
+		}
+
+		void reset() override { rendered = false; }
+
+		unsigned int iterationTexture() const override { return texture; }
+		unsigned int distanceTexture() const override { return 0; }
+		int reachedIterations() const override { return last.maxIterations; }
+
+		std::string status() const override {
+			return "hybrid, " + std::to_string((int)(gpuShare * 100 + 0.5)) + "% on the GPU";
+		}
+
+	private:
+		static double area(const TileGrid::Rect& r) { return (double)r.width * r.height; }
+
+		// picks up how long the GPU took over the last frame if the query has its result, and moves the
+		// split towards where both sides take the same time. a frame that follows straight on from the last
+		// can find it still running, and then keeps the old GPU rate rather than stall the pipeline
+		void measure() {
+			if (!measuring)
+				return;
+			measuring = false;
+			GLuint available = 0;
+			glGetQueryObjectuiv(timer, GL_QUERY_RESULT_AVAILABLE, &available);
+			GLuint64 nanoseconds = 0;
+			if (available)
+				glGetQueryObjectui64v(timer, GL_QUERY_RESULT, &nanoseconds);
+			if (gpuPixels > 0 && nanoseconds > 0) {
+				double rate = gpuPixels / (nanoseconds * 1e-9);
+				gpuRate = gpuRate > 0 ? (gpuRate + rate) / 2 : rate;
+			}
+			if (cpuPixels > 0 && cpuSeconds > 0) {
+				double rate = cpuPixels / cpuSeconds;
+				cpuRate = cpuRate > 0 ? (cpuRate + rate) / 2 : rate;
+			}
+			if (gpuRate > 0 && cpuRate > 0)
+				gpuShare = gpuRate / (gpuRate + cpuRate);
+		}
+
+		ProgramCache& programs;
+		ThreadPool& pool;
+		unsigned int framebuffer, texture, timer;
+		IterateUniforms uniforms;
+		CountBuffer counts; // the CPU's tiles
+		std::vector<int> gpuTiles, cpuTiles;
+		TileCostModel costs;
+		FrameView last = { 0, 0, 0, 0, 0, 0 };
+		std::string lastKernel;
+		bool rendered = false;
+
+		// pixels a second on each side, averaged over the last few frames
+		double gpuRate = 0, cpuRate = 0;
+		double gpuShare = 0.5;
+		double gpuPixels = 0, cpuPixels = 0, cpuSeconds = 0;
+		bool measuring = false; // the timer query holds a frame not measured yet
+	};
+}
+
+std::unique_ptr<Renderer> makeRenderer(Backend backend, ProgramCache& programs, ThreadPool& pool) {
+	switch (backend) {
+	case Backend::GPU_COMPUTE:
+		if (!GLEW_ARB_compute_shader || !GLEW_ARB_shader_image_load_store)
+			return nullptr;
+		return std::unique_ptr<Renderer>(new ComputeRenderer(programs));
+	case Backend::CPU_SCALAR:
+		return std::unique_ptr<Renderer>(new CpuRenderer(pool, false));
+	case Backend::CPU_SIMD:
+		return std::unique_ptr<Renderer>(new CpuRenderer(pool, true));
+	case Backend::HYBRID:
+		if (!GLEW_ARB_timer_query)
+			return nullptr;
+		return std::unique_ptr<Renderer>(new HybridRenderer(programs, pool));
+	default:
+		return std::unique_ptr<Renderer>(new FragmentRenderer(programs));
+	}
+}
+
+// the counts a renderer left in its texture, capped at maxIterations as the color pass caps them
+static std::vector<unsigned int> readCounts(const Renderer& renderer, const FrameView& view) {
+	std::vector<unsigned int> counts((size_t)view.width * view.height);
+	glBindTexture(GL_TEXTURE_2D, renderer.iterationTexture());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, counts.data());
+	for (unsigned int& count : counts)
+		count = std::min(count, (unsigned int)view.maxIterations);
+	return counts;
+}
+
+void benchmarkRenderers(const FrameView& view, const KernelVariant& variant, int frames, ProgramCache& programs, ThreadPool& pool) {
+	std::vector<unsigned int> reference;
+	// the scalar kernels first, everything else is compared with them
+	const Backend order[BACKEND_COUNT] = { Backend::CPU_SCALAR, Backend::CPU_SIMD, Backend::GPU_FRAGMENT, Backend::GPU_COMPUTE, Backend::HYBRID };
+	for (Backend backend : order) {
+		std::unique_ptr<Renderer> renderer = makeRenderer(backend, programs, pool);
+		if (!renderer) {
+			std::cout << backendName(backend) << ": not supported by this driver" << std::endl;
+			continue;
+		}
+		// a few times untimed, which waits for its shader, allocates its textures and lets the hybrid
+		// renderer settle on a split
+		KernelVariant kernel = variant;
+		bool distance = false;
+		// renders that take more than one pass go on until they are done
+		auto renderAll = [&]() {
+			renderer->reset();
+			do
+				renderer->render(view, kernel, distance);
+			while (renderer->reachedIterations() < view.maxIterations);
+			glFinish();
+		};
+		for (int i = 0; i < 3; i++)
+			renderAll();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; i++)
+			renderAll();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / frames;
+
+		std::vector<unsigned int> counts = readCounts(*renderer, view);
+		if (reference.empty())
+			reference = counts;
+		long long differing = 0;
+		for (size_t i = 0; i < counts.size(); i++)
+			differing += counts[i] != reference[i];
+		std::cout << renderer->status() << ": " << seconds * 1000 << " ms per frame, "
+			<< (double)view.width * view.height / seconds / 1e6 << " Mpixels/s, "
+			<< differing << " pixels differ from cpu" << std::endl;
+	}
+}
+
+ColorPass::ColorPass(unsigned int colorProgram) : program(colorProgram) {
+	glUseProgram(program);
+	maxIterationsLocation = glGetUniformLocation(program, "maxIterations");
+	reachedIterationsLocation = glGetUniformLocation(program, "reachedIterations");
+	boundaryShadingLocation = glGetUniformLocation(program, "boundaryShading");
+	glUniform1i(glGetUniformLocation(program, "iterationTexture"), 0);
+	glUniform1i(glGetUniformLocation(program, "distanceTexture"), 1);
+}
+
+void ColorPass::draw(unsigned int iterationTexture, unsigned int distanceTexture, int maxIterations, int reachedIterations) const {
+	glUseProgram(program);
+	glUniform1i(maxIterationsLocation, maxIterations);
+	glUniform1i(reachedIterationsLocation, reachedIterations);
+	glUniform1i(boundaryShadingLocation, distanceTexture ? 1 : 0);
+	if (distanceTexture) {
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, distanceTexture);
+	}
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, iterationTexture);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "formula.h"
+
+class ProgramCache;
+class ThreadPool;
+
+// a view as the shader takes it: both axes span [-scale, scale] around the center
+struct FrameView {
+	double centerX, centerY, scale;
+	int width, height;
+	int maxIterations;
+};
+
+enum class Backend {
+	GPU_FRAGMENT, // iterateShader.glsl drawn into a framebuffer
+	GPU_COMPUTE, // the same shader as a compute shader, on drivers that have them
+	CPU_SCALAR, // the kernels of formula.h, a pixel at a time
+	CPU_SIMD, // LaneKernel, a row at a time in lockstep lanes
+	HYBRID // the view's tiles split between the fragment pass and LaneKernel, both working at once
+};
+
+static const int BACKEND_COUNT = 5;
+
+const char* backendName(Backend backend);
+// gpu, compute, cpu, simd or hybrid
+bool parseBackend(const std::string& text, Backend& out);
+
+// computes the iteration counts of a view into textures for the color pass. a renderer keeps what it
+// computed: it only works when the view or maxIterations changed, and the GPU ones continue orbits from
+// where they stopped when only maxIterations went up
+class Renderer {
+public:
+	virtual ~Renderer() {}
+
+	virtual Backend backend() const = 0;
+
+	// brings the textures up to the view. distance asks for estimates as well, which only the Mandelbrot
+	// set in doubles has, and is cleared when the textures have none
+	virtual void render(const FrameView& view, const KernelVariant& variant, bool& distance) = 0;
+	// forgets what was computed, so the next render starts over
+	virtual void reset() = 0;
+
+	// R32UI counts, bottom row first
+	virtual unsigned int iterationTexture() const = 0;
+	// R32F estimates in pixels
+	virtual unsigned int distanceTexture() const = 0;
+
+	// the cap the counts have got to. the GPU renderers take a render of many iterations a pass a frame,
+	// and until this reaches maxIterations the counts at it are orbits still running, which the next
+	// render carries on
+	virtual int reachedIterations() const = 0;
+
+	// the backend's name, and anything it has to say about how the last render went
+	virtual std::string status() const { return backendName(backend()); }
+};
+
+// null if the driver can't run this backend. the CPU backends render on pool
+std::unique_ptr<Renderer> makeRenderer(Backend backend, ProgramCache& programs, ThreadPool& pool);
+
+// renders the view from scratch frames times with every backend the driver has, and prints how long each
+// took and how many pixels it counted differently from the scalar CPU kernels
+void benchmarkRenderers(const FrameView& view, const KernelVariant& variant, int frames, ProgramCache& programs, ThreadPool& pool);
+
+// turns counts into the frame, in whatever framebuffer and viewport are bound
+class ColorPass {
+public:
+	explicit ColorPass(unsigned int colorProgram);
+
+	// shades the boundary with distance estimates if distanceTexture isn't 0. counts at reachedIterations,
+	// of a render that hasn't got to maxIterations yet, show as inside the set until they are decided
+	void draw(unsigned int iterationTexture, unsigned int distanceTexture, int maxIterations, int reachedIterations) const;
+
+private:
+	unsigned int program;
+	int maxIterationsLocation, reachedIterationsLocation, boundaryShadingLocation;
+};
@@ -0,0 +1,55 @@
+#include "shaderSources.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+namespace {
+	struct ShaderFile {
+		const char* name;
+		const char* file;
+	};
+
+	// the same pairs as shaders.rc
+	const ShaderFile SHADER_FILES[] = {
+		{ VERTEX_SHADER, "vertexShader.glsl" },
+		{ FRAGMENT_SHADER, "fragmentShader.glsl" },
+		{ ITERATE_SHADER, "iterateShader.glsl" }
+	};
+
+	std::string readFile(const char* name) {
+		for (const ShaderFile& shader : SHADER_FILES) {
+			if (strcmp(shader.name, name) != 0)
+				continue;
+			std::ifstream file(shader.file);
+			if (!file)
+				break;
+			std::stringstream stream;
+			stream << file.rdbuf();
+			return stream.str();
+		}
+		return "";
+	}
+}
+
+std::string embeddedShader(const char* name) {
+#ifdef _WIN32
+	HRSRC resource = FindResourceA(NULL, name, MAKEINTRESOURCEA(10)); // RT_RCDATA
+	HGLOBAL data = resource ? LoadResource(NULL, resource) : NULL;
+	const char* bytes = data ? (const char*)LockResource(data) : nullptr;
+	// resources aren't null terminated
+	if (bytes)
+		return std::string(bytes, SizeofResource(NULL, resource));
+#endif
+	std::string source = readFile(name);
+	if (source.empty())
+		std::cout << "Shader " << name << " is neither embedded nor next to the executable" << std::endl;
+	return source;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+
+// resource names of the shaders embedded by shaders.rc
+#define VERTEX_SHADER "VERTEX_SHADER"
+#define FRAGMENT_SHADER "FRAGMENT_SHADER"
+#define ITERATE_SHADER "ITERATE_SHADER"
+
+// the source of an embedded shader. builds without resources read the .glsl file instead. empty, with a
+// message, if neither is there
+std::string embeddedShader(const char* name);
@@ -0,0 +1,127 @@
+#include "supersample.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdlib.h>
+#include <type_traits>
+#include <vector>
+
+
+// largest per channel difference, in 0-255, before a pixel counts as aliased
+static const int NEIGHBOUR_CONTRAST = 48;
+static const int SUBSAMPLE_CONTRAST = 48;
+
+static int contrast(const unsigned char* a, const unsigned char* b) {
+	int d = 0;
+	for (int c = 0; c < 3; c++)
+		d = std::max(d, abs(a[c] - b[c]));
+	return d;
+}
+
+namespace {
+	template <typename Kernel>
+	struct Sampler {
+		Kernel kernel;
+		double centerX, centerY, scale;
+		int width, height, maxIterations;
+
+		// fx, fy in pixels from the top left corner of the image
+		void sample(double fx, double fy, unsigned char* rgb) const {
+			double cr = (fx / width * 2.0 - 1.0) * scale + centerX;
+			double ci = ((height - fy) / height * 2.0 - 1.0) * scale + centerY;
+			colorIterations(kernel(cr, ci, maxIterations), maxIterations, rgb);
+		}
+
+		// the pixel centers of a row, all at once so the kernel can batch them
+		void sampleRow(double fy, unsigned char* rgb) const {
+			std::vector<double> cr(width);
+			std::vector<int> iterations(width);
+			for (int px = 0; px < width; px++)
+				cr[px] = ((px + 0.5) / width * 2.0 - 1.0) * scale + centerX;
+			double ci = ((height - fy) / height * 2.0 - 1.0) * scale + centerY;
+			kernel.row(cr.data(), ci, width, maxIterations, iterations.data(), nullptr);
+			for (int px = 0; px < width; px++)
+				colorIterations(iterations[px], maxIterations, rgb + px * 3);
+		}
+	};
+}
+
+template <typename Kernel>
+static SupersampleStats renderWith(const Sampler<Kernel>& sampler, ThreadPool& pool, unsigned char* rgb) {
+	int width = sampler.width, height = sampler.height;
+
+	std::vector<unsigned char> base((size_t)width * height * 3);
+	pool.parallelFor(height, [&](int py) {
+		sampler.sampleRow(py + 0.5, &base[(size_t)py * width * 3]);
+	});
+
+	// rotated grid offsets for the first refinement, 4x4 stratified grid for the second
+	static const double rotatedGrid[4][2] = { { -0.125, -0.375 }, { 0.375, -0.125 }, { 0.125, 0.375 }, { -0.375, 0.125 } };
+	std::atomic<long long> refined{ 0 }, samples{ (long long)width * height };
+
+	pool.parallelFor(height, [&](int py) {
+		long long rowRefined = 0, rowSamples = 0;
+		for (int px = 0; px < width; px++) {
+			const unsigned char* center = &base[((size_t)py * width + px) * 3];
+			unsigned char* out = rgb + ((size_t)py * width + px) * 3;
+
+			int neighbourhood = 0;
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					int nx = px + dx, ny = py + dy;
+					if (nx >= 0 && ny >= 0 && nx < width && ny < height)
+						neighbourhood = std::max(neighbourhood, contrast(center, &base[((size_t)ny * width + nx) * 3]));
+				}
+			}
+			if (neighbourhood < NEIGHBOUR_CONTRAST) {
+				std::copy(center, center + 3, out);
+				continue;
+			}
+
+			rowRefined++;
+			unsigned char sub[5][3];
+			std::copy(center, center + 3, sub[0]);
+			int spread = 0;
+			for (int s = 0; s < 4; s++) {
+				sampler.sample(px + 0.5 + rotatedGrid[s][0], py + 0.5 + rotatedGrid[s][1], sub[s + 1]);
+				spread = std::max(spread, contrast(sub[0], sub[s + 1]));
+			}
+			rowSamples += 4;
+
+			int sum[3] = { 0, 0, 0 };
+			int count = 0;
+			for (int s = 0; s < 5; s++, count++)
+				for (int c = 0; c < 3; c++)
+					sum[c] += sub[s][c];
+			if (spread >= SUBSAMPLE_CONTRAST) {
+				// still resolving detail below the sample spacing, so add 16 more to the 5 already taken
+				for (int sy = 0; sy < 4; sy++) {
+					for (int sx = 0; sx < 4; sx++, count++) {
+						unsigned char s[3];
+						sampler.sample(px + (sx + 0.5) / 4, py + (sy + 0.5) / 4, s);
+						for (int c = 0; c < 3; c++)
+							sum[c] += s[c];
+					}
+				}
+				rowSamples += 16;
+			}
+			for (int c = 0; c < 3; c++)
+				out[c] = (unsigned char)((sum[c] + count / 2) / count);
+		}
+		refined += rowRefined;
+		samples += rowSamples;
+	});
+
+	double pixels = (double)width * height;
+	return { refined / pixels, samples / pixels };
+}
+
+SupersampleStats renderAdaptive(double centerX, double centerY, double scale, int width, int height, int maxIterations,
+	ThreadPool& pool, unsigned char* rgb, const KernelVariant& variant) {
+	SupersampleStats stats;
+	withKernel(variant, [&](const auto& kernel) {
+		Sampler<std::decay_t<decltype(kernel)>> sampler = { kernel, centerX, centerY, scale, width, height, maxIterations };
+		stats = renderWith(sampler, pool, rgb);
+	});
+	return stats;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "formula.h"
+#include "threadPool.h"
+
+// adaptive antialiasing for exported frames. every pixel gets one sample; pixels whose neighbourhood
+// shows high contrast get 4 more rotated grid samples, and those that still disagree add a 4x4 grid to them.
+struct SupersampleStats {
+	double refinedFraction; // pixels that got at least the 4 extra samples
+	double samplesPerPixel;
+};
+
+// renders the view with the explorer's mapping into a top-down RGB buffer
+SupersampleStats renderAdaptive(double centerX, double centerY, double scale, int width, int height, int maxIterations,
+	ThreadPool& pool, unsigned char* rgb, const KernelVariant& variant = KernelVariant());
@@ -0,0 +1,89 @@
+#include "threadPool.h"
+
+#include "numa.h"
+
+// the node a pool's worker is pinned to, -1 on other threads
+static thread_local int workerNode = -1;
+
+ThreadPool::ThreadPool(unsigned int threadCount, int numaNodes) : pinnedToNodes(numaNodes > 0) {
+	int nodes = std::max(1, std::min(numaNodes, numaNodeCount()));
+	unsigned int processors = 0;
+	for (int node = 0; node < nodes; node++)
+		processors += numaNodeProcessors(node);
+	if (threadCount == 0)
+		threadCount = numaNodes > 0 ? processors : std::thread::hardware_concurrency();
+	if (threadCount == 0)
+		threadCount = 1;
+	nodeWorkers.assign(numaNodes > 0 ? nodes : 1, 0);
+	nodeJobs.resize(nodeWorkers.size());
+	// each node's share of the workers follows its share of the processors
+	unsigned int placed = 0, seen = 0;
+	for (int node = 0; node < nodeCount(); node++) {
+		seen += numaNodes > 0 ? numaNodeProcessors(node) : processors;
+		unsigned int upTo = numaNodes > 0 ? (unsigned int)((unsigned long long)threadCount * seen / processors) : threadCount;
+		for (; placed < upTo; placed++) {
+			nodeWorkers[node]++;
+			workers.emplace_back(&ThreadPool::workerLoop, this, numaNodes > 0 ? node : -1);
+		}
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		stopping = true;
+	}
+	jobsAvailable.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+int ThreadPool::callerNode() const {
+	if (nodeCount() == 1)
+		return 0;
+	int node = workerNode >= 0 ? workerNode : currentNumaNode();
+	return std::min(node, nodeCount() - 1);
+}
+
+void ThreadPool::post(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		jobs.push_back(std::move(job));
+	}
+	jobsAvailable.notify_one();
+}
+
+void ThreadPool::post(std::function<void()> job, int node) {
+	if (nodeCount() == 1 || workersOnNode(node) == 0) {
+		post(std::move(job));
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(jobsMutex);
+		nodeJobs[node].push_back(std::move(job));
+	}
+	// only a worker of that node may take it
+	jobsAvailable.notify_all();
+}
+
+void ThreadPool::workerLoop(int node) {
+	if (node >= 0) {
+		pinToNumaNode(node);
+		workerNode = node;
+	}
+	std::deque<std::function<void()>>* ownJobs = node >= 0 ? &nodeJobs[node] : nullptr;
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobsAvailable.wait(lock, [&]() { return stopping || !jobs.empty() || (ownJobs && !ownJobs->empty()); });
+			// drain the queues before exiting so destroying the pool never drops work. a node's own jobs come first
+			std::deque<std::function<void()>>& from = ownJobs && !ownJobs->empty() ? *ownJobs : jobs;
+			if (from.empty())
+				return;
+			job = std::move(from.front());
+			from.pop_front();
+		}
+		job();
+	}
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed size pool of worker threads pulling jobs from a shared FIFO queue. a pool can also be spread over
+// NUMA nodes, with every worker pinned to the processors of one node and a queue of jobs for each node,
+// which only that node's workers take
+class ThreadPool {
+public:
+	// threadCount of 0 uses one worker per hardware thread. numaNodes of 0 leaves the workers wherever the
+	// OS puts them, otherwise they are pinned over the first numaNodes nodes, in proportion to how many
+	// processors each has, and threadCount 0 is every processor of those nodes
+	explicit ThreadPool(unsigned int threadCount = 0, int numaNodes = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int size() const { return (unsigned int)workers.size(); }
+	// 1 for a pool that isn't pinned
+	int nodeCount() const { return (int)nodeWorkers.size(); }
+	bool pinned() const { return pinnedToNodes; }
+	int workersOnNode(int node) const { return nodeWorkers[node]; }
+	// the node of the calling thread, a worker's own or the one the OS has it on
+	int callerNode() const;
+
+	void post(std::function<void()> job);
+	// runs job on a worker of node
+	void post(std::function<void()> job, int node);
+
+	// runs body(node) once on a worker of every node and returns once all are done, such as to touch memory
+	// first from the node it should live on
+	template <typename F>
+	void forEachNode(F body) {
+		std::vector<std::future<void>> done;
+		for (int node = 0; node < nodeCount(); node++) {
+			auto task = std::make_shared<std::packaged_task<void()>>([&body, node]() { body(node); });
+			done.push_back(task->get_future());
+			post([task]() { (*task)(); }, node);
+		}
+		for (std::future<void>& d : done)
+			d.get();
+	}
+
+	template <typename F>
+	auto submit(F f) -> std::future<decltype(f())> {
+		auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::move(f));
+		std::future<decltype(f())> result = task->get_future();
+		post([task]() { (*task)(); });
+		return result;
+	}
+
+	// runs body(i) for every i in [0, count) across the pool and returns once all are done. the calling
+	// thread takes items too, so this is safe to call from inside a job running on the same pool.
+	template <typename F>
+	void parallelFor(int count, F body) {
+		struct State {
+			std::atomic<int> next{ 0 };
+			std::atomic<int> done{ 0 };
+			std::mutex doneMutex;
+			std::condition_variable allDone;
+		};
+		auto state = std::make_shared<State>();
+		// helpers that only start after everything is done claim nothing, so body is never touched after return
+		auto work = [state, count, &body]() {
+			int i;
+			while ((i = state->next++) < count) {
+				body(i);
+				if (++state->done == count) {
+					std::lock_guard<std::mutex> lock(state->doneMutex);
+					state->allDone.notify_all();
+				}
+			}
+		};
+		for (unsigned int t = 1; t < size() && t < (unsigned int)count; t++)
+			post(work);
+		work();
+		std::unique_lock<std::mutex> lock(state->doneMutex);
+		state->allDone.wait(lock, [&]() { return state->done == count; });
+	}
+
+	// runs body(item) for every item, as parallelFor does, on per thread deques with work stealing. the items
+	// are dealt round robin in the order given, so with them sorted longest first every thread starts on the
+	// largest of its share. a thread works from the front of its own deque, and once that is empty it steals
+	// from the back of the others', where the cheapest items are, so the frame ends on small pieces of work.
+	// on a pool spread over nodes, nodeOf(item) says which node's threads the item goes to, and a thread
+	// steals from the other deques of its node before it steals from another node
+	template <typename F>
+	void parallelForEach(const std::vector<int>& items, F body) {
+		parallelForEach(items, [](int) { return 0; }, body);
+	}
+
+	template <typename NodeOf, typename F>
+	void parallelForEach(const std::vector<int>& items, NodeOf nodeOf, F body) {
+		int count = (int)items.size();
+		if (count == 0)
+			return;
+		struct Queue {
+			std::mutex queueMutex;
+			std::deque<int> items;
+		};
+		struct State {
+			std::vector<Queue> queues;
+			std::vector<int> firstQueue, queueCount; // the queues of each node
+			std::unique_ptr<std::atomic<int>[]> joined; // threads of each node so far
+			std::atomic<int> done{ 0 };
+			std::mutex doneMutex;
+			std::condition_variable allDone;
+		};
+		int nodes = nodeCount();
+		auto state = std::make_shared<State>();
+		std::vector<std::vector<int>> nodeItems(nodes);
+		for (int item : items)
+			nodeItems[nodes > 1 ? nodeOf(item) % nodes : 0].push_back(item);
+		int queues = 0;
+		for (int node = 0; node < nodes; node++) {
+			state->firstQueue.push_back(queues);
+			state->queueCount.push_back(std::min(std::max(workersOnNode(node), 1), (int)nodeItems[node].size()));
+			queues += state->queueCount[node];
+		}
+		state->queues = std::vector<Queue>(queues);
+		state->joined.reset(new std::atomic<int>[nodes]);
+		for (int node = 0; node < nodes; node++) {
+			state->joined[node] = 0;
+			for (size_t i = 0; i < nodeItems[node].size(); i++)
+				state->queues[state->firstQueue[node] + i % state->queueCount[node]].items.push_back(nodeItems[node][i]);
+		}
+
+		auto take = [state](int queue, bool front, int& item) {
+			Queue& q = state->queues[queue];
+			std::lock_guard<std::mutex> lock(q.queueMutex);
+			if (q.items.empty())
+				return false;
+			item = front ? q.items.front() : q.items.back();
+			if (front)
+				q.items.pop_front();
+			else
+				q.items.pop_back();
+			return true;
+		};
+		// as in parallelFor, a helper that starts after everything is done finds nothing and never touches body
+		auto work = [state, nodes, queues, count, take, &body](int node) {
+			int local = state->queueCount[node], first = state->firstQueue[node];
+			int self = local > 0 ? first + state->joined[node]++ % local : -1;
+			int item;
+			while (true) {
+				bool found = self >= 0 && take(self, true, item);
+				// this node's other queues, then everyone else's
+				for (int k = 1; !found && k < local; k++)
+					found = take(first + (self - first + k) % local, false, item);
+				for (int k = 0; !found && k < queues; k++) {
+					if (k < first || k >= first + local)
+						found = take(k, false, item);
+				}
+				if (!found)
+					return;
+				body(item);
+				if (++state->done == count) {
+					std::lock_guard<std::mutex> lock(state->doneMutex);
+					state->allDone.notify_all();
+				}
+			}
+		};
+		int own = callerNode();
+		for (int node = 0; node < nodes; node++) {
+			for (int t = node == own ? 1 : 0; t < state->queueCount[node]; t++) {
+				if (nodes > 1)
+					post([work, node]() { work(node); }, node);
+				else
+					post([work]() { work(0); });
+			}
+		}
+		work(own);
+		std::unique_lock<std::mutex> lock(state->doneMutex);
+		state->allDone.wait(lock, [&]() { return state->done == count; });
+	}
+
+private:
+	void workerLoop(int node);
+
+	std::vector<std::thread> workers;
+	std::vector<int> nodeWorkers;
+	std::deque<std::function<void()>> jobs;
+	std::vector<std::deque<std::function<void()>>> nodeJobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobsAvailable;
+	bool pinnedToNodes;
+	bool stopping = false;
+};
@@ -0,0 +1,59 @@
+#include "tileCache.h"
+
+TileCache::TileCache(size_t capacityBytes) : capacity(capacityBytes) {}
+
+TileCache::Tile TileCache::getOrRender(const std::string& key, const std::function<std::string()>& render) {
+	std::promise<Tile> promise;
+	{
+		std::unique_lock<std::mutex> lock(cacheMutex);
+		auto cached = entries.find(key);
+		if (cached != entries.end()) {
+			lru.splice(lru.begin(), lru, cached->second.lruPosition);
+			hitCount++;
+			return cached->second.tile;
+		}
+		auto pending = inFlight.find(key);
+		if (pending != inFlight.end()) {
+			std::shared_future<Tile> result = pending->second;
+			lock.unlock();
+			coalescedCount++;
+			return result.get();
+		}
+		inFlight.emplace(key, promise.get_future().share());
+		missCount++;
+	}
+
+	// render outside the lock so that other tiles can be served meanwhile
+	Tile tile;
+	try {
+		tile = std::make_shared<const std::string>(render());
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		inFlight.erase(key);
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		insert(key, tile);
+		inFlight.erase(key);
+	}
+	promise.set_value(tile);
+	return tile;
+}
+
+void TileCache::insert(const std::string& key, const Tile& tile) {
+	if (tile->size() > capacity)
+		return;
+	lru.push_front(key);
+	entries[key] = { tile, lru.begin() };
+	usedBytes += tile->size();
+	while (usedBytes > capacity) {
+		auto evicted = entries.find(lru.back());
+		usedBytes -= evicted->second.tile->size();
+		entries.erase(evicted);
+		lru.pop_back();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// thread safe LRU cache of encoded tiles, bounded by the total size of the cached bytes.
+// requests for a tile that is already being rendered wait on that render instead of starting their own.
+class TileCache {
+public:
+	typedef std::shared_ptr<const std::string> Tile;
+
+	explicit TileCache(size_t capacityBytes);
+
+	Tile getOrRender(const std::string& key, const std::function<std::string()>& render);
+
+	size_t hits() const { return hitCount; }
+	size_t misses() const { return missCount; }
+	size_t coalesced() const { return coalescedCount; }
+
+private:
+	struct Entry {
+		Tile tile;
+		std::list<std::string>::iterator lruPosition;
+	};
+
+	void insert(const std::string& key, const Tile& tile);
+
+	size_t capacity;
+	size_t usedBytes = 0;
+	std::list<std::string> lru; // most recently used at the front
+	std::unordered_map<std::string, Entry> entries;
+	std::unordered_map<std::string, std::shared_future<Tile>> inFlight;
+	std::mutex cacheMutex;
+
+	std::atomic<size_t> hitCount{ 0 };
+	std::atomic<size_t> missCount{ 0 };
+	std::atomic<size_t> coalescedCount{ 0 };
+};
@@ -0,0 +1,318 @@
+#include "tileSchedule.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string.h>
+#include <thread>
+
+#include "numa.h"
+#include "perfCounter.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SSE2_SWIZZLE
+#endif
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	enum class Strategy {
+		STATIC, // an equal block of tiles per thread, decided up front
+		DYNAMIC, // tiles in row order from a shared counter, parallelFor
+		PREDICTED_PREPASS, // longest first with stealing, predicted by the pre-pass every frame
+		PREDICTED_PREVIOUS // the same, predicted by the previous frame's iteration sums
+	};
+
+	const char* strategyName(Strategy strategy) {
+		switch (strategy) {
+		case Strategy::STATIC: return "static blocks";
+		case Strategy::DYNAMIC: return "row order, shared counter";
+		case Strategy::PREDICTED_PREPASS: return "longest first, pre-pass";
+		default: return "longest first, previous frame";
+		}
+	}
+
+	// when each thread finished its last tile of the frame
+	struct FinishTimes {
+		std::mutex timesMutex;
+		std::map<std::thread::id, Clock::time_point> last;
+
+		void finished() {
+			Clock::time_point now = Clock::now();
+			std::lock_guard<std::mutex> lock(timesMutex);
+			last[std::this_thread::get_id()] = now;
+		}
+	};
+}
+
+CountBuffer::~CountBuffer() {
+	releaseMemory(counts, bytes);
+}
+
+void CountBuffer::allocate(const TileGrid& grid, ThreadPool& pool) {
+	if (counts && grid.width == placed.width && grid.height == placed.height && grid.tileSize == placed.tileSize && pool.nodeCount() == nodes)
+		return;
+	releaseMemory(counts, bytes);
+	bytes = (size_t)grid.count() * grid.tileSize * grid.tileSize * sizeof(unsigned int);
+	counts = (unsigned int*)reserveMemory(bytes);
+	placed = grid;
+	nodes = pool.nodeCount();
+
+	// a node's band of tile rows, one run of blocks
+	size_t rowBytes = (size_t)grid.columns() * grid.tileSize * grid.tileSize * sizeof(unsigned int);
+	auto band = [&](int node, size_t& offset, size_t& size) {
+		offset = firstTileRow(grid, node, nodes) * rowBytes;
+		size = firstTileRow(grid, node + 1, nodes) * rowBytes - offset;
+	};
+	bool touch = false;
+	for (int node = 0; node < nodes; node++) {
+		size_t offset, size;
+		band(node, offset, size);
+		if (size > 0 && !placeOnNumaNode((char*)counts + offset, size, pool.pinned() ? node : -1))
+			touch = true;
+	}
+	// where the OS places pages on first touch, each node's workers touch their own band. an unpinned pool's
+	// pages go wherever its threads first write them
+	if (touch && pool.pinned()) {
+		pool.forEachNode([&](int node) {
+			size_t offset, size;
+			band(node, offset, size);
+			memset((char*)counts + offset, 0, size);
+		});
+	}
+}
+
+// one row of a tile into the row major counts, eight at a time
+static void copyRow(const unsigned int* from, unsigned int* to, int count) {
+	int i = 0;
+#ifdef SSE2_SWIZZLE
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(from + i)), b = _mm_loadu_si128((const __m128i*)(from + i + 4));
+		_mm_storeu_si128((__m128i*)(to + i), a);
+		_mm_storeu_si128((__m128i*)(to + i + 4), b);
+	}
+#endif
+	for (; i < count; i++)
+		to[i] = from[i];
+}
+
+void CountBuffer::copyToRows(unsigned int* rows, ThreadPool& pool) const {
+	std::vector<int> tileRows(placed.rows());
+	for (int r = 0; r < placed.rows(); r++)
+		tileRows[r] = r;
+	pool.parallelForEach(tileRows, [&](int r) { return r * pool.nodeCount() / placed.rows(); }, [&](int r) {
+		for (int c = 0; c < placed.columns(); c++) {
+			TileGrid::Rect rect = placed.rect(r * placed.columns() + c);
+			const unsigned int* block = tile(r * placed.columns() + c);
+			// the block and the texture both go bottom up, so its first row is the lowest of the tile
+			for (int y = 0; y < rect.height; y++)
+				copyRow(block + (size_t)y * placed.tileSize, rows + (size_t)(placed.height - rect.y - rect.height + y) * placed.width + rect.x, rect.width);
+		}
+	});
+}
+
+// renderTile into row major counts, bottom row first, the layout the counts had before CountBuffer
+template <typename Kernel>
+static double renderRowMajorTile(const Kernel& kernel, const FrameView& view, const TileGrid::Rect& r, const double* cr, unsigned int* counts) {
+	double sum = 0;
+	for (int py = r.y; py < r.y + r.height; py++) {
+		double ci = pixelImaginary(view.centerY, view.scale, py, view.height);
+		int* row = (int*)counts + (size_t)(view.height - 1 - py) * view.width + r.x;
+		kernel.row(cr + r.x, ci, r.width, view.maxIterations, row, nullptr);
+		for (int px = 0; px < r.width; px++)
+			sum += row[px];
+	}
+	return sum;
+}
+
+// the benchmarks' calls into the kernel, the only part of them made once per kernel variant. the strategy
+// loops around them are compiled a single time and call through these
+namespace {
+	struct TileKernel {
+		std::function<double(int tile, CountBuffer& counts)> render;
+		std::function<double(const TileGrid::Rect& r, unsigned int* rows)> renderRowMajor;
+		std::function<double(const TileGrid::Rect& r)> estimate;
+	};
+}
+
+// cr has to outlive the result
+static TileKernel tileKernel(const FrameView& view, const KernelVariant& variant, const double* cr) {
+	TileKernel result;
+	withKernel<LaneKernel>(variant, [&](const auto& kernel) {
+		// copied, the visitor's kernel is gone once withKernel returns
+		auto own = kernel;
+		result.render = [own, view, cr](int tile, CountBuffer& counts) { return renderTile(own, view, tile, cr, counts); };
+		result.renderRowMajor = [own, view, cr](const TileGrid::Rect& r, unsigned int* rows) { return renderRowMajorTile(own, view, r, cr, rows); };
+		result.estimate = [own, view](const TileGrid::Rect& r) { return estimateTileCost(own, view, r); };
+	});
+	return result;
+}
+
+void benchmarkTileScheduling(const FrameView& view, const KernelVariant& variant, int frames, ThreadPool& pool) {
+	TileGrid grid = { view.width, view.height, CPU_TILE };
+	std::vector<double> cr(view.width);
+	for (int px = 0; px < view.width; px++)
+		cr[px] = pixelReal(view.centerX, view.scale, px, view.width);
+	CountBuffer counts;
+	counts.allocate(grid, pool);
+	std::vector<unsigned int> rows((size_t)view.width * view.height), reference;
+	int threads = (int)pool.size();
+	std::cout << grid.count() << " tiles of " << grid.tileSize << " pixels on " << threads << " threads" << std::endl;
+
+	TileKernel kernel = tileKernel(view, variant, cr.data());
+	for (Strategy strategy : { Strategy::STATIC, Strategy::DYNAMIC, Strategy::PREDICTED_PREPASS, Strategy::PREDICTED_PREVIOUS }) {
+		TileCostModel model;
+		double total = 0, idle = 0;
+		// one untimed frame first, which also gives the previous frame strategy its costs
+		for (int frame = -1; frame < frames; frame++) {
+			if (strategy != Strategy::PREDICTED_PREVIOUS)
+				model.reset();
+			FinishTimes times;
+			Clock::time_point start = Clock::now();
+			bool predicted = strategy == Strategy::PREDICTED_PREPASS || strategy == Strategy::PREDICTED_PREVIOUS;
+			auto tile = [&](int t) {
+				double cost = kernel.render(t, counts);
+				if (predicted)
+					model.record(t, cost);
+				times.finished();
+			};
+			if (strategy == Strategy::STATIC) {
+				pool.parallelFor(threads, [&](int block) {
+					for (int t = block * grid.count() / threads; t < (block + 1) * grid.count() / threads; t++)
+						tile(t);
+				});
+			}
+			else if (strategy == Strategy::DYNAMIC) {
+				pool.parallelFor(grid.count(), tile);
+			}
+			else {
+				std::vector<int> order = model.longestFirst(view, grid, pool, [&](int t) { return kernel.estimate(grid.rect(t)); });
+				pool.parallelForEach(order, tile);
+			}
+			Clock::time_point end = Clock::now();
+			if (frame < 0)
+				continue;
+			double seconds = std::chrono::duration<double>(end - start).count();
+			total += seconds;
+			// a thread that never got a tile was idle for the whole frame
+			double idleSeconds = (threads - (int)times.last.size()) * seconds;
+			for (auto& finish : times.last)
+				idleSeconds += std::chrono::duration<double>(end - finish.second).count();
+			idle += idleSeconds / threads;
+		}
+		counts.copyToRows(rows.data(), pool);
+		if (reference.empty())
+			reference = rows;
+		std::cout << strategyName(strategy) << ": " << total / frames * 1000 << " ms per frame, "
+			<< idle / total * 100 << "% of it idle at the end" << (rows == reference ? "" : ", counts differ") << std::endl;
+	}
+}
+
+void benchmarkNumaScaling(const FrameView& view, const KernelVariant& variant, int frames) {
+	TileGrid grid = { view.width, view.height, CPU_TILE };
+	std::vector<double> cr(view.width);
+	for (int px = 0; px < view.width; px++)
+		cr[px] = pixelReal(view.centerX, view.scale, px, view.width);
+	int nodes = numaNodeCount();
+	std::cout << grid.count() << " tiles of " << grid.tileSize << " pixels, " << nodes << " NUMA node" << (nodes == 1 ? "" : "s") << std::endl;
+
+	struct Setup {
+		const char* name;
+		int numaNodes; // for the pool, 0 unpinned
+		bool placed; // counts in node bands, or all first touched by the calling thread
+	};
+	const Setup setups[] = {
+		{ "1 node, pinned and placed", 1, true },
+		{ "every node, pinned and placed", nodes, true },
+		{ "every node, unpinned, counts from the calling thread", 0, false }
+	};
+	std::vector<unsigned int> reference;
+	double oneNode = 0;
+	TileKernel kernel = tileKernel(view, variant, cr.data());
+	for (int s = 0; s < 3; s++) {
+		const Setup& setup = setups[s];
+		// on one node the second setup is the first again
+		if (s == 1 && nodes == 1)
+			continue;
+		ThreadPool pool(0, setup.numaNodes);
+		CountBuffer counts;
+		counts.allocate(grid, pool);
+		if (!setup.placed)
+			memset(counts.tile(0), 0, counts.size() * sizeof(unsigned int));
+		TileCostModel model;
+		double total = 0;
+		// one untimed frame first, which also gives the model its costs
+		for (int frame = -1; frame < frames; frame++) {
+			Clock::time_point start = Clock::now();
+			std::vector<int> order = model.longestFirst(view, grid, pool, [&](int t) { return kernel.estimate(grid.rect(t)); });
+			pool.parallelForEach(order, [&](int t) { return tileNode(grid, t, pool.nodeCount()); },
+				[&](int t) { model.record(t, kernel.render(t, counts)); });
+			if (frame >= 0)
+				total += std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		std::vector<unsigned int> result((size_t)view.width * view.height);
+		counts.copyToRows(result.data(), pool);
+		if (reference.empty())
+			reference = result;
+		double rate = (double)view.width * view.height * frames / total / 1e6;
+		if (s == 0)
+			oneNode = rate;
+		std::cout << setup.name << ": " << pool.size() << " threads, " << rate << " Mpixels/s";
+		if (s > 0)
+			std::cout << ", " << rate / oneNode << "x one node";
+		std::cout << (result == reference ? "" : ", counts differ") << std::endl;
+	}
+}
+
+void benchmarkCountLayout(const FrameView& view, const KernelVariant& variant, int frames) {
+	TileGrid grid = { view.width, view.height, CPU_TILE };
+	std::vector<double> cr(view.width);
+	for (int px = 0; px < view.width; px++)
+		cr[px] = pixelReal(view.centerX, view.scale, px, view.width);
+	std::cout << grid.count() << " tiles of " << grid.tileSize << " pixels" << std::endl;
+
+	std::vector<unsigned int> reference;
+	TileKernel kernel = tileKernel(view, variant, cr.data());
+	for (bool tiled : { false, true }) {
+		// the counter before the pool, so that it counts the workers too
+		CacheMissCounter counter;
+		ThreadPool pool(0, numaNodeCount());
+		CountBuffer counts;
+		counts.allocate(grid, pool);
+		std::vector<unsigned int> rows((size_t)view.width * view.height);
+		TileCostModel model;
+		double renderSeconds = 0, copySeconds = 0;
+		// one untimed frame first, which also gives the model its costs
+		for (int frame = -1; frame < frames; frame++) {
+			if (frame == 0)
+				counter.start();
+			Clock::time_point start = Clock::now();
+			std::vector<int> order = model.longestFirst(view, grid, pool, [&](int t) { return kernel.estimate(grid.rect(t)); });
+			pool.parallelForEach(order, [&](int t) { return tileNode(grid, t, pool.nodeCount()); }, [&](int t) {
+				model.record(t, tiled ? kernel.render(t, counts) : kernel.renderRowMajor(grid.rect(t), rows.data()));
+			});
+			Clock::time_point rendered = Clock::now();
+			// what the renderers upload
+			if (tiled)
+				counts.copyToRows(rows.data(), pool);
+			if (frame >= 0) {
+				renderSeconds += std::chrono::duration<double>(rendered - start).count();
+				copySeconds += std::chrono::duration<double>(Clock::now() - rendered).count();
+			}
+		}
+		counter.stop();
+		if (reference.empty())
+			reference = rows;
+		std::cout << (tiled ? "tile major: " : "row major: ") << renderSeconds / frames * 1000 << " ms per frame";
+		if (tiled)
+			std::cout << " and " << copySeconds / frames * 1000 << " ms copying to rows";
+		if (counter.available())
+			std::cout << ", " << counter.misses() / frames << " cache misses per frame";
+		else
+			std::cout << ", no cache miss counter available";
+		std::cout << (rows == reference ? "" : ", counts differ") << std::endl;
+	}
+}
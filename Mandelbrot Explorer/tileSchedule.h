@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "formula.h"
+#include "renderer.h"
+#include "threadPool.h"
+
+// tiles of a view, tileSize pixels square, numbered row by row from the top left
+struct TileGrid {
+	int width, height, tileSize;
+
+	struct Rect {
+		int x, y, width, height; // y from the top of the view
+	};
+
+	int columns() const { return (width + tileSize - 1) / tileSize; }
+	int rows() const { return (height + tileSize - 1) / tileSize; }
+	int count() const { return columns() * rows(); }
+
+	Rect rect(int tile) const {
+		int x = tile % columns() * tileSize, y = tile / columns() * tileSize;
+		return { x, y, std::min(tileSize, width - x), std::min(tileSize, height - y) };
+	}
+};
+
+// the node whose threads render a tile on a pool spread over nodes. the view is cut into one band of whole
+// tile rows per node, so a node's tiles, and their part of the counts, lie together
+inline int tileNode(const TileGrid& grid, int tile, int nodes) {
+	return tile / grid.columns() * nodes / grid.rows();
+}
+
+// the first tile row of a node's band, and of the next node's where its band ends
+inline int firstTileRow(const TileGrid& grid, int node, int nodes) {
+	return (node * grid.rows() + nodes - 1) / nodes;
+}
+
+// the counts of a view, kept tile by tile rather than row by row: every tile has a tileSize x tileSize
+// block of its own with its rows bottom first as the textures take them, so a tile's pixels share cache
+// lines and pages only with each other, and edge tiles leave the end of their block unused. the memory of
+// each node's band of tiles is on that node, so its threads write locally. it is never zeroed, every
+// render writes every pixel
+class CountBuffer {
+public:
+	CountBuffer() = default;
+	~CountBuffer();
+
+	CountBuffer(const CountBuffer&) = delete;
+	CountBuffer& operator=(const CountBuffer&) = delete;
+
+	// sized for grid, its bands placed on pool's nodes. nothing happens while the grid stays the same
+	void allocate(const TileGrid& grid, ThreadPool& pool);
+
+	const TileGrid& grid() const { return placed; }
+	// every count, the unused ends of edge tiles included
+	size_t size() const { return bytes / sizeof(unsigned int); }
+
+	// a tile's block, rows grid().tileSize counts apart
+	unsigned int* tile(int t) { return counts + (size_t)t * placed.tileSize * placed.tileSize; }
+	const unsigned int* tile(int t) const { return counts + (size_t)t * placed.tileSize * placed.tileSize; }
+
+	// the count of pixel px, py from the top left
+	unsigned int& at(int px, int py) {
+		int size = placed.tileSize, top = py / size * size;
+		int rows = std::min(size, placed.height - top);
+		return tile(top / size * placed.columns() + px / size)[(rows - 1 - (py - top)) * size + px % size];
+	}
+
+	// the view row by row into rows, bottom row first as glTexSubImage2D takes it, on pool with each band
+	// of tiles read by its own node
+	void copyToRows(unsigned int* rows, ThreadPool& pool) const;
+
+private:
+	unsigned int* counts = nullptr;
+	size_t bytes = 0;
+	TileGrid placed = { 0, 0, 0 };
+	int nodes = 0;
+};
+
+// side of the CPU renderers' tiles, small enough for a few hundred in a frame so that there are many per
+// thread to balance
+static const int CPU_TILE = 32;
+
+// predicts what each tile of a view costs, so the slowest can start first: an interior tile runs
+// maxIterations for every pixel while one far outside escapes in a few steps, and a slow tile picked up
+// last leaves every other thread idle until it is done. the prediction is the iteration sum of the tile
+// from the last render of the same view, or else a coarse pre-pass that iterates a few pixels of each tile
+class TileCostModel {
+public:
+	// the tiles, most expensive first. estimate(tile) gives the pre-pass cost of a tile, and runs on pool for
+	// every tile without a cost. it can give a negative cost for a tile this render won't take, which sorts
+	// last and is estimated again the next time
+	template <typename Estimate>
+	std::vector<int> longestFirst(const FrameView& view, const TileGrid& grid, ThreadPool& pool, Estimate estimate) {
+		bool known = costs.size() == (size_t)grid.count() && view.centerX == last.centerX && view.centerY == last.centerY
+			&& view.scale == last.scale && view.width == last.width && view.height == last.height && grid.tileSize == tileSize;
+		if (!known) {
+			costs.assign(grid.count(), -1.0);
+			last = view;
+			tileSize = grid.tileSize;
+		}
+		std::vector<int> unknown;
+		for (int i = 0; i < grid.count(); i++) {
+			if (costs[i] < 0)
+				unknown.push_back(i);
+		}
+		pool.parallelFor((int)unknown.size(), [&](int i) { costs[unknown[i]] = estimate(unknown[i]); });
+		std::vector<int> order(grid.count());
+		for (int i = 0; i < grid.count(); i++)
+			order[i] = i;
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return costs[a] > costs[b]; });
+		return order;
+	}
+
+	// what a tile of the view last passed to longestFirst actually cost. tiles are recorded from different
+	// threads at once
+	void record(int tile, double cost) { costs[tile] = cost; }
+
+	void reset() { costs.clear(); }
+
+private:
+	FrameView last = { 0, 0, 0, 0, 0, 0 };
+	int tileSize = 0;
+	std::vector<double> costs;
+};
+
+// pixels on a side of the pre-pass's sample grid in every tile, 16 samples of a 32 pixel tile's 1024
+static const int COST_SAMPLES = 4;
+
+// the pre-pass: iterations of COST_SAMPLES x COST_SAMPLES pixels spread over the tile, scaled to its area
+template <typename Kernel>
+double estimateTileCost(const Kernel& kernel, const FrameView& view, const TileGrid::Rect& r) {
+	double sum = 0;
+	for (int sy = 0; sy < COST_SAMPLES; sy++) {
+		int py = r.y + (2 * sy + 1) * r.height / (2 * COST_SAMPLES);
+		for (int sx = 0; sx < COST_SAMPLES; sx++) {
+			int px = r.x + (2 * sx + 1) * r.width / (2 * COST_SAMPLES);
+			sum += kernel(pixelReal(view.centerX, view.scale, px, view.width), pixelImaginary(view.centerY, view.scale, py, view.height),
+				view.maxIterations);
+		}
+	}
+	return sum * r.width * r.height / (COST_SAMPLES * COST_SAMPLES);
+}
+
+// counts one tile into its block of counts and returns the tile's iteration sum
+template <typename Kernel>
+double renderTile(const Kernel& kernel, const FrameView& view, int tile, const double* cr, CountBuffer& counts) {
+	const TileGrid& grid = counts.grid();
+	TileGrid::Rect r = grid.rect(tile);
+	double sum = 0;
+	for (int py = r.y; py < r.y + r.height; py++) {
+		double ci = pixelImaginary(view.centerY, view.scale, py, view.height);
+		int* row = (int*)counts.tile(tile) + (size_t)(r.y + r.height - 1 - py) * grid.tileSize;
+		kernel.row(cr + r.x, ci, r.width, view.maxIterations, row, nullptr);
+		for (int px = 0; px < r.width; px++)
+			sum += row[px];
+	}
+	return sum;
+}
+
+// renders the view on the CPU in tiles under each scheduling strategy, frames times each, and prints the
+// time per frame and how much of it threads sat idle at the end waiting for the last tile
+void benchmarkTileScheduling(const FrameView& view, const KernelVariant& variant, int frames, ThreadPool& pool);
+
+// renders the view in tiles, frames times, on a pool on one node, on every node with the tiles and counts
+// placed by node, and on every node unpinned with the counts all touched first by the calling thread, and
+// prints the pixels a second of each and how the nodes scale over one
+void benchmarkNumaScaling(const FrameView& view, const KernelVariant& variant, int frames);
+
+// renders the view in tiles, frames times, into row major counts and into a CountBuffer copied out to
+// rows afterwards, and prints the time per frame of each and its last level cache misses where the OS
+// gives out the hardware counters
+void benchmarkCountLayout(const FrameView& view, const KernelVariant& variant, int frames);
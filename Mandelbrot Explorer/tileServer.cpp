@@ -0,0 +1,284 @@
+#include "tileServer.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "formula.h"
+#include "pngEncode.h"
+#include "threadPool.h"
+#include "tileCache.h"
+
+static const int TILE_SIZE = 256;
+// past this the pixel spacing drops below double precision and tiles turn into blocks
+static const int MAX_TILE_ZOOM = 42;
+
+static bool initSockets() {
+#ifdef _WIN32
+	WSADATA wsaData;
+	return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+#else
+	return true;
+#endif
+}
+
+static void setTimeout(socket_t s, int seconds) {
+#ifdef _WIN32
+	DWORD ms = seconds * 1000;
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&ms, sizeof(ms));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&ms, sizeof(ms));
+#else
+	timeval tv = { seconds, 0 };
+	setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#endif
+}
+
+static bool sendAll(socket_t s, const char* data, size_t length) {
+	while (length > 0) {
+		int sent = send(s, data, (int)std::min<size_t>(length, 1 << 20), 0);
+		if (sent <= 0)
+			return false;
+		data += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+static void sendResponse(socket_t s, const char* status, const char* contentType, const std::string& body) {
+	std::ostringstream header;
+	header << "HTTP/1.1 " << status << "\r\n"
+		<< "Content-Type: " << contentType << "\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Access-Control-Allow-Origin: *\r\n";
+	// a tile's pixels depend only on its url, so browsers may keep it
+	if (status[0] == '2')
+		header << "Cache-Control: public, max-age=86400\r\n";
+	header << "Connection: close\r\n\r\n";
+	std::string h = header.str();
+	if (sendAll(s, h.data(), h.size()))
+		sendAll(s, body.data(), body.size());
+}
+
+struct TileRequest {
+	int z;
+	long long x, y;
+	int iterations;
+};
+
+// parses "/{z}/{x}/{y}.png" with an optional "?iter=N" query
+static bool parseTilePath(const std::string& target, int defaultIterations, TileRequest& request) {
+	std::string path = target, query;
+	size_t q = target.find('?');
+	if (q != std::string::npos) {
+		path = target.substr(0, q);
+		query = target.substr(q + 1);
+	}
+
+	char extension[8] = { 0 };
+	char trailing;
+	if (sscanf(path.c_str(), "/%d/%lld/%lld.%7[a-z]%c", &request.z, &request.x, &request.y, extension, &trailing) != 4)
+		return false;
+	if (std::string(extension) != "png")
+		return false;
+
+	request.iterations = defaultIterations;
+	std::istringstream params(query);
+	std::string param;
+	while (std::getline(params, param, '&')) {
+		if (param.compare(0, 5, "iter=") == 0) {
+			char* end;
+			long value = strtol(param.c_str() + 5, &end, 10);
+			if (*end != '\0' || end == param.c_str() + 5)
+				return false;
+			request.iterations = (int)std::min<long>(value, 1L << 30);
+		}
+	}
+	return true;
+}
+
+static std::string renderTile(const TileRequest& request, const KernelVariant& variant) {
+	double tileSpan = 4.0 / (double)(1LL << request.z);
+	double centerX = -2.5 + (request.x + 0.5) * tileSpan;
+	double centerY = 2.0 - (request.y + 0.5) * tileSpan;
+	std::vector<unsigned char> rgb(TILE_SIZE * TILE_SIZE * 3);
+	renderView(centerX, centerY, tileSpan / 2, TILE_SIZE, TILE_SIZE, request.iterations, rgb.data(), variant);
+	return encodePng(rgb.data(), TILE_SIZE, TILE_SIZE);
+}
+
+static void handleConnection(socket_t client, const TileServerOptions& options, TileCache& cache) {
+	setTimeout(client, 10);
+
+	std::string request;
+	char buffer[2048];
+	while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+		int received = recv(client, buffer, sizeof(buffer), 0);
+		if (received <= 0)
+			break;
+		request.append(buffer, received);
+	}
+
+	std::istringstream line(request.substr(0, request.find("\r\n")));
+	std::string method, target;
+	line >> method >> target;
+
+	TileRequest tile;
+	if (method != "GET") {
+		sendResponse(client, "405 Method Not Allowed", "text/plain", "only GET is supported\n");
+	}
+	else if (!parseTilePath(target, options.defaultIterations, tile)) {
+		sendResponse(client, "404 Not Found", "text/plain", "expected /{z}/{x}/{y}.png?iter=N\n");
+	}
+	else if (tile.z < 0 || tile.z > MAX_TILE_ZOOM || tile.x < 0 || tile.y < 0
+		|| tile.x >= (1LL << tile.z) || tile.y >= (1LL << tile.z)) {
+		sendResponse(client, "404 Not Found", "text/plain", "tile out of range\n");
+	}
+	else if (tile.iterations < 1 || tile.iterations > options.iterationLimit) {
+		sendResponse(client, "400 Bad Request", "text/plain", "iter out of range\n");
+	}
+	else {
+		std::string key = std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" + std::to_string(tile.y) + "@" + std::to_string(tile.iterations);
+		TileCache::Tile png = cache.getOrRender(key, [&tile, &options]() { return renderTile(tile, options.variant); });
+		sendResponse(client, "200 OK", "image/png", *png);
+	}
+
+	closesocket(client);
+}
+
+int runTileServer(const TileServerOptions& options) {
+	if (!initSockets()) {
+		std::cout << "Could not initialise sockets" << std::endl;
+		return -1;
+	}
+
+	socket_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((unsigned short)options.port);
+	if (listener == INVALID_SOCKET || bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) {
+		std::cout << "Could not listen on port " << options.port << std::endl;
+		return -1;
+	}
+
+	TileCache cache(options.cacheBytes);
+	ThreadPool pool(options.threads);
+	std::cout << "Serving tiles on http://localhost:" << options.port << "/{z}/{x}/{y}.png?iter=N with "
+		<< pool.size() << " threads" << std::endl;
+
+	while (true) {
+		socket_t client = accept(listener, NULL, NULL);
+		if (client == INVALID_SOCKET)
+			continue;
+		pool.post([client, &options, &cache]() {
+			try {
+				handleConnection(client, options, cache);
+			}
+			catch (const std::exception& e) {
+				std::cout << "Tile request failed: " << e.what() << std::endl;
+				closesocket(client);
+			}
+		});
+	}
+}
+
+// one request over a fresh connection; returns false on anything other than a 200
+static bool fetchTile(int port, const std::string& target) {
+	socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return false;
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons((unsigned short)port);
+	setTimeout(s, 60);
+	if (connect(s, (sockaddr*)&address, sizeof(address)) != 0) {
+		closesocket(s);
+		return false;
+	}
+
+	std::string request = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+	std::string response;
+	if (sendAll(s, request.data(), request.size())) {
+		char buffer[16384];
+		int received;
+		while ((received = recv(s, buffer, sizeof(buffer), 0)) > 0)
+			response.append(buffer, received);
+	}
+	closesocket(s);
+	return response.compare(0, 12, "HTTP/1.1 200") == 0;
+}
+
+int runTileLoadTest(int port, int requests, int concurrency, int maxZoom, int iterations) {
+	if (!initSockets())
+		return -1;
+	concurrency = std::max(1, concurrency);
+
+	std::vector<std::vector<double>> latencies(concurrency);
+	std::atomic<int> issued{ 0 }, failures{ 0 };
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> clients;
+	for (int c = 0; c < concurrency; c++) {
+		clients.emplace_back([&, c]() {
+			// low zoom levels have few tiles, so the mix naturally contains repeats and simultaneous duplicates
+			std::mt19937 rng(1234 + c);
+			while (issued++ < requests) {
+				int z = std::uniform_int_distribution<int>(0, maxZoom)(rng);
+				std::uniform_int_distribution<long long> coordinate(0, (1LL << z) - 1);
+				long long x = coordinate(rng), y = coordinate(rng);
+				std::string target = "/" + std::to_string(z) + "/" + std::to_string(x) + "/" + std::to_string(y)
+					+ ".png?iter=" + std::to_string(iterations);
+
+				auto sent = std::chrono::steady_clock::now();
+				if (!fetchTile(port, target))
+					failures++;
+				latencies[c].push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+			}
+		});
+	}
+	for (std::thread& client : clients)
+		client.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::vector<double> all;
+	for (const std::vector<double>& l : latencies)
+		all.insert(all.end(), l.begin(), l.end());
+	if (all.empty())
+		return -1;
+	std::sort(all.begin(), all.end());
+	auto percentile = [&all](double p) { return all[std::min(all.size() - 1, (size_t)(p / 100.0 * all.size()))]; };
+
+	std::cout << all.size() << " requests, " << concurrency << " clients, " << failures << " failed, "
+		<< all.size() / seconds << " req/s" << std::endl;
+	std::cout << "latency ms  p50 " << percentile(50) << "  p90 " << percentile(90) << "  p99 " << percentile(99)
+		<< "  p99.9 " << percentile(99.9) << "  max " << all.back() << std::endl;
+	return failures > 0 ? 1 : 0;
+}
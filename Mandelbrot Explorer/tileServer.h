@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "formula.h"
+
+// slippy map server mode: answers GET /{z}/{x}/{y}.png?iter=N with 256x256 tiles.
+// zoom level 0 is a single tile covering real [-2.5, 1.5] and imaginary [-2, 2].
+struct TileServerOptions {
+	int port = 8080;
+	unsigned int threads = 0; // 0 = one per hardware thread
+	size_t cacheBytes = 256 * 1024 * 1024;
+	int defaultIterations = 256;
+	int iterationLimit = 1 << 20; // requests above this are rejected so one client can't stall the pool
+	KernelVariant variant; // one formula per server, so it needs no place in the tile cache key
+};
+
+// blocks serving requests, returns non-zero if the listening socket could not be opened
+int runTileServer(const TileServerOptions& options);
+
+// fires requests random tiles at a local server from concurrent clients and prints the latency distribution
+int runTileLoadTest(int port, int requests, int concurrency, int maxZoom, int iterations);
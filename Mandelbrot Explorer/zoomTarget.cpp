@@ -0,0 +1,229 @@
+#include "zoomTarget.h"
+
+#include <algorithm>
+#include <vector>
+
+// Newton steps before giving up, enough to gain a few thousand bits
+static const int MAX_NEWTON_STEPS = 64;
+// extra precision for Misiurewicz points, which have no size to stop a dive at
+static const int MISIUREWICZ_LIMBS = 4;
+// orbits this far out are escaping, and would soon overflow BigFixed's integer limb
+static const double NEWTON_BAILOUT = 1e3;
+
+namespace {
+	struct Complex {
+		FloatExp r, i;
+	};
+
+	Complex operator+(const Complex& a, const Complex& b) { return { a.r + b.r, a.i + b.i }; }
+	Complex operator-(const Complex& a, const Complex& b) { return { a.r - b.r, a.i - b.i }; }
+	Complex operator*(const Complex& a, const Complex& b) { return { a.r * b.r - a.i * b.i, a.r * b.i + a.i * b.r }; }
+	FloatExp norm(const Complex& a) { return a.r * a.r + a.i * a.i; }
+	Complex divide(const Complex& a, const Complex& b) {
+		FloatExp d = norm(b);
+		return { (a.r * b.r + a.i * b.i) / d, (a.i * b.r - a.r * b.i) / d };
+	}
+
+	Complex toComplex(const BigFixed& x, const BigFixed& y) {
+		return { x.toFloatExp(), y.toFloatExp() };
+	}
+
+	// Z_n and dZ_n/dc, the derivative carried in FloatExp since it grows without bound
+	struct Orbit {
+		Orbit(const BigFixed& cx, const BigFixed& cy) : cx(cx), cy(cy), zx(cx.fractionLimbs()), zy(cx.fractionLimbs()) {}
+
+		const BigFixed& cx;
+		const BigFixed& cy;
+		BigFixed zx, zy;
+		Complex dz = { 0.0, 0.0 };
+		int n = 0;
+
+		void step() {
+			Complex z = toComplex(zx, zy);
+			dz = Complex{ 2.0, 0.0 } * z * dz + Complex{ 1.0, 0.0 };
+			BigFixed xy = zx * zy;
+			zx = zx * zx - zy * zy + cx;
+			zy = xy + xy + cy;
+			n++;
+		}
+
+		bool escaping() const { return fabs(zx.toDouble()) + fabs(zy.toDouble()) > NEWTON_BAILOUT; }
+	};
+
+	// one Newton step on Z_{m+p}(c) - Z_m(c) = 0, a nucleus when m is 0 (Z_0 = 0 and its derivative is 0).
+	// sets how far c moved, false if the orbit escapes or the derivative vanishes
+	bool newtonStep(BigFixed& cx, BigFixed& cy, int preperiod, int period, FloatExp& moved) {
+		Orbit orbit(cx, cy);
+		BigFixed mx = orbit.zx, my = orbit.zy;
+		Complex dm = orbit.dz;
+		while (orbit.n < preperiod + period) {
+			orbit.step();
+			if (orbit.escaping())
+				return false;
+			if (orbit.n == preperiod) {
+				mx = orbit.zx;
+				my = orbit.zy;
+				dm = orbit.dz;
+			}
+		}
+		// the difference is taken in full precision, it's all that is left near the root
+		Complex f = toComplex(orbit.zx - mx, orbit.zy - my);
+		Complex df = orbit.dz - dm;
+		if (norm(df) <= 0.0)
+			return false;
+		Complex delta = divide(f, df);
+		int limbs = cx.fractionLimbs();
+		cx = cx - BigFixed::fromFloatExp(delta.r, limbs);
+		cy = cy - BigFixed::fromFloatExp(delta.i, limbs);
+		moved = sqrt(norm(delta));
+		return true;
+	}
+
+	// steps until c moves by less than the last limb resolves
+	bool newton(BigFixed& cx, BigFixed& cy, int preperiod, int period) {
+		FloatExp resolution(1.0, -32 * (int64_t)(cx.fractionLimbs() - 1));
+		for (int step = 0; step < MAX_NEWTON_STEPS; step++) {
+			FloatExp moved;
+			if (!newtonStep(cx, cy, preperiod, period, moved))
+				return false;
+			if (moved < resolution)
+				return true;
+		}
+		return false;
+	}
+
+	bool near(const BigFixed& x, const BigFixed& y, const BigFixed& cx, const BigFixed& cy, const FloatExp& distance) {
+		int limbs = x.fractionLimbs();
+		Complex d = toComplex(x - cx.withPrecision(limbs), y - cy.withPrecision(limbs));
+		return norm(d) <= distance * distance;
+	}
+}
+
+int findPeriod(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations) {
+	int limbs = std::max(cx.fractionLimbs(), BigFixed::limbsForScale(radius));
+	BigFixed px = cx.withPrecision(limbs), py = cy.withPrecision(limbs);
+	Orbit orbit(px, py);
+	FloatExp radius2 = radius * radius;
+	while (orbit.n < maxIterations) {
+		orbit.step();
+		// to first order the disk maps to one of radius |dZ_n/dc| radius around Z_n
+		FloatExp z2 = norm(toComplex(orbit.zx, orbit.zy));
+		if (z2 < radius2 * norm(orbit.dz))
+			return orbit.n;
+		if (z2 >= 4.0)
+			return 0;
+	}
+	return 0;
+}
+
+bool findPreperiod(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations, int& preperiod, int& period) {
+	int limbs = std::max(cx.fractionLimbs(), BigFixed::limbsForScale(radius));
+	BigFixed px = cx.withPrecision(limbs), py = cy.withPrecision(limbs);
+	Orbit orbit(px, py);
+	FloatExp radius2 = radius * radius;
+	// the last MAX_MISIUREWICZ_PERIOD steps, Z_n and its derivative at n % size
+	const int size = MAX_MISIUREWICZ_PERIOD + 1;
+	std::vector<Complex> z(size), dz(size);
+	while (orbit.n < maxIterations) {
+		orbit.step();
+		int n = orbit.n;
+		z[n % size] = toComplex(orbit.zx, orbit.zy);
+		dz[n % size] = orbit.dz;
+		if (norm(z[n % size]) >= 4.0)
+			return false;
+		// Z_m for m >= 1 only, m = 0 is a nucleus
+		for (int p = 1; p <= MAX_MISIUREWICZ_PERIOD && p < n; p++) {
+			int m = n - p;
+			if (norm(z[n % size] - z[m % size]) < radius2 * norm(dz[n % size] - dz[m % size])) {
+				preperiod = m;
+				period = p;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+FloatExp nucleusSize(const BigFixed& cx, const BigFixed& cy, int period) {
+	BigFixed zx = cx, zy = cy;
+	Complex l = { 1.0, 0.0 }, b = { 1.0, 0.0 };
+	for (int j = 1; j < period; j++) {
+		l = Complex{ 2.0, 0.0 } * toComplex(zx, zy) * l;
+		if (norm(l) <= 0.0)
+			return 0.0;
+		b = b + divide({ 1.0, 0.0 }, l);
+		BigFixed xy = zx * zy;
+		zx = zx * zx - zy * zy + cx;
+		zy = xy + xy + cy;
+	}
+	return 1.0 / (sqrt(norm(b)) * norm(l));
+}
+
+ZoomTarget locateNucleus(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations) {
+	ZoomTarget target;
+	target.period = findPeriod(cx, cy, radius, maxIterations);
+	if (target.period == 0)
+		return target;
+	int limbs = std::max(cx.fractionLimbs(), BigFixed::limbsForScale(radius));
+	target.x = cx.withPrecision(limbs);
+	target.y = cy.withPrecision(limbs);
+	if (!newton(target.x, target.y, 0, target.period))
+		return target;
+	// the nucleus has to be resolved well below the minibrot's size for a dive to end on it
+	target.size = nucleusSize(target.x, target.y, target.period);
+	int needed = BigFixed::limbsForScale(target.size);
+	if (needed > limbs) {
+		target.x = target.x.withPrecision(needed);
+		target.y = target.y.withPrecision(needed);
+		if (!newton(target.x, target.y, 0, target.period))
+			return target;
+		target.size = nucleusSize(target.x, target.y, target.period);
+	}
+	// the disk test is only first order, so allow for some distance beyond the radius
+	target.found = target.size > 0.0 && near(target.x, target.y, cx, cy, radius * 4.0);
+	return target;
+}
+
+ZoomTarget locateMisiurewicz(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations) {
+	ZoomTarget target;
+	if (!findPreperiod(cx, cy, radius, maxIterations, target.preperiod, target.period))
+		return target;
+	int limbs = std::max(cx.fractionLimbs(), BigFixed::limbsForScale(radius)) + MISIUREWICZ_LIMBS;
+	target.x = cx.withPrecision(limbs);
+	target.y = cy.withPrecision(limbs);
+	if (!newton(target.x, target.y, target.preperiod, target.period))
+		return target;
+
+	// the root also solves Z_{m'+q} = Z_{m'} for any q dividing p from some m' <= m on. report the
+	// smallest such pair, which may turn out to be a nucleus (m' = 0)
+	int steps = target.preperiod + target.period;
+	std::vector<BigFixed> zx, zy;
+	std::vector<Complex> dz;
+	Orbit orbit(target.x, target.y);
+	for (int n = 0; n <= steps; n++) {
+		zx.push_back(orbit.zx);
+		zy.push_back(orbit.zy);
+		dz.push_back(orbit.dz);
+		orbit.step();
+	}
+	FloatExp resolution(1.0, -32 * (int64_t)(limbs - 2));
+	bool reduced = false;
+	for (int q = 1; q <= target.period && !reduced; q++) {
+		if (target.period % q != 0)
+			continue;
+		for (int m = 0; m <= target.preperiod && !reduced; m++) {
+			// a root of this pair if a Newton step on it would move c by no more than the precision
+			Complex f = toComplex(zx[m + q] - zx[m], zy[m + q] - zy[m]);
+			if (norm(f) <= resolution * resolution * norm(dz[m + q] - dz[m])) {
+				target.preperiod = m;
+				target.period = q;
+				reduced = true;
+			}
+		}
+	}
+	target.misiurewicz = target.preperiod > 0;
+	if (!target.misiurewicz)
+		target.size = nucleusSize(target.x, target.y, target.period);
+	target.found = near(target.x, target.y, cx, cy, radius * 4.0);
+	return target;
+}
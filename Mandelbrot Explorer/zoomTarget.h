@@ -0,0 +1,40 @@
+#pragma once
+
+#include "bigFixed.h"
+
+// zoom targets found with Newton's method instead of by hand, so a long dive ends somewhere worth the
+// render. a rough location is iterated to find the period of the feature nearest it, then refined in
+// high precision to the exact point:
+//   a minibrot's nucleus, the c of period p where Z_p(c) = 0, together with the minibrot's size
+//   a Misiurewicz point, where the orbit lands on a cycle of period p after m steps: Z_{m+p}(c) = Z_m(c)
+// the derivatives that Newton divides by are kept as FloatExp, so each step gains about as many bits as a
+// double holds however deep the target is.
+
+struct ZoomTarget {
+	bool found = false;
+	bool misiurewicz = false;
+	BigFixed x, y;
+	int preperiod = 0; // 0 for a nucleus
+	int period = 0;
+	// for a nucleus the size of the minibrot, the scale at which it fills the view the way the whole set
+	// does at scale 1. 0 for a Misiurewicz point, which looks the same at every depth
+	FloatExp size;
+};
+
+// the period of the first minibrot whose nucleus lies within radius of c, from the iteration of c itself:
+// the first n where the disk of that radius around c maps onto a disk around Z_n that contains 0.
+// 0 if there is none before maxIterations or the orbit escapes first
+int findPeriod(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations);
+// the same for Misiurewicz points: the first m + p where the disk maps onto disks around Z_m and Z_{m+p}
+// that overlap, with periods up to MAX_MISIUREWICZ_PERIOD. false if there is none
+bool findPreperiod(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations, int& preperiod, int& period);
+
+static const int MAX_MISIUREWICZ_PERIOD = 64;
+
+// the minibrot nearest a rough location, searched within radius of it
+ZoomTarget locateNucleus(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations);
+ZoomTarget locateMisiurewicz(const BigFixed& cx, const BigFixed& cy, const FloatExp& radius, int maxIterations);
+
+// the minibrot size estimate from the orbit of a nucleus: with l_j = prod_{k<=j} 2 Z_k and b = sum_{j<p} 1 / l_j,
+// the size is |1 / (b l_{p-1}^2)|
+FloatExp nucleusSize(const BigFixed& cx, const BigFixed& cy, int period);